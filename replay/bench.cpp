@@ -0,0 +1,438 @@
+// drives every exported study of user.cpp with a synthetic time and sales
+// and depth stream and reports, per study, the mean ns per update, heap
+// allocations and bytes per update, and p50 / p99 / p999 / max call latency.
+// allocations are counted only inside study calls after the warmup.
+//
+//		bench [-p PRINTS] [-l LEVELS] [-u PRINTS_PER_UPDATE] [-c CHANGES] [-w WARMUP] [-m MS] [study ...]
+//
+//		-p PRINTS				prints of the chart symbol per study (100000), 10k to 10M
+//		-l LEVELS				depth levels per side (10), 10 to 1000
+//		-u PRINTS_PER_UPDATE	prints between study calls (4)
+//		-c CHANGES				depth levels changed per side between calls (4)
+//		-w WARMUP				calls not measured (1000)
+//		-m MS					session time between calls (10)
+//
+// the chart symbol X trades in 0.25 ticks around 5000, the second leg Y in
+// 1/32 around 110. each study runs alone on a fresh market.
+
+#include "harness.h"
+
+#include <new>
+#include <random>
+
+
+// allocation counting
+
+static bool			counting	= false;
+static long long	allocs		= 0;
+static long long	alloc_bytes	= 0;
+
+static void * counted_alloc(const size_t n) {
+
+	if (counting) {
+
+		allocs++;
+		alloc_bytes += static_cast<long long>(n);
+
+	}
+
+	void * p = std::malloc(n != 0 ? n : 1);
+
+	if (p == NULL)
+
+		throw std::bad_alloc();
+
+	return p;
+
+}
+
+void * operator new(const size_t n) { return counted_alloc(n); }
+void * operator new[](const size_t n) { return counted_alloc(n); }
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+void operator delete[](void * p, size_t) noexcept { std::free(p); }
+
+
+#define X_SYMBOL	"XZ4"
+#define Y_SYMBOL	"YZ4"
+#define X_TICK		0.25f
+#define Y_TICK		0.03125f
+#define MAX_PROFILES	20
+
+
+// a random walk of one symbol's inside, its depth and its prints
+
+struct synthetic_symbol {
+
+	const char *	symbol;
+	float			tick_size;
+	int				bid		= 0;	// ticks
+	int				levels	= 0;
+
+	void open(const char * symbol_, const float tick_size_, const float price, const int levels_, std::mt19937 & rng) {
+
+		symbol		= symbol_;
+		tick_size	= tick_size_;
+		bid			= static_cast<int>(price / tick_size);
+		levels		= levels_;
+
+		market_tick_size(symbol, tick_size);
+
+		std::uniform_int_distribution<int> qty(1, 200);
+
+		for (int type : { SC_TS_BID, SC_TS_ASK }) {
+
+			std::vector<s_MarketDepthEntry> & side = market_side(symbol, type);
+
+			side.clear();
+
+			for (int i = 0; i < levels; i++)
+
+				market_level(side, i, price_at(type, i), qty(rng));
+
+		}
+
+	}
+
+	float price_at(const int type, const int level) const {
+
+		return (type == SC_TS_BID ? bid - level : bid + 1 + level) * tick_size;
+
+	}
+
+	// moves the inside by one tick, shifting both sides; the new inside
+	// level of the advancing side is small, the far level filled in
+
+	void move(const int dir, std::mt19937 & rng) {
+
+		std::uniform_int_distribution<int> qty(1, 200);
+
+		std::vector<s_MarketDepthEntry> & bids = market_side(symbol, SC_TS_BID);
+		std::vector<s_MarketDepthEntry> & asks = market_side(symbol, SC_TS_ASK);
+		std::vector<s_MarketDepthEntry> & from = dir > 0 ? asks : bids;
+		std::vector<s_MarketDepthEntry> & to   = dir > 0 ? bids : asks;
+
+		bid += dir;
+
+		// the side moving away loses its inside level
+
+		from.erase(from.begin());
+		from.push_back(s_MarketDepthEntry());
+
+		to.insert(to.begin(), s_MarketDepthEntry());
+		to.pop_back();
+
+		for (int type : { SC_TS_BID, SC_TS_ASK }) {
+
+			std::vector<s_MarketDepthEntry> & side = type == SC_TS_BID ? bids : asks;
+
+			for (int i = 0; i < levels; i++) {
+
+				side[i].Price			= price_at(type, i);
+				side[i].AdjustedPrice	= side[i].Price;
+
+			}
+
+		}
+
+		market_level(to, 0, to[0].Price, qty(rng) / 10 + 1);
+		market_level(from, levels - 1, from[levels - 1].Price, qty(rng));
+
+	}
+
+	void change(const int changes, std::mt19937 & rng) {
+
+		std::uniform_int_distribution<int> level(0, levels - 1);
+		std::uniform_int_distribution<int> qty(1, 200);
+
+		for (int type : { SC_TS_BID, SC_TS_ASK }) {
+
+			std::vector<s_MarketDepthEntry> & side = market_side(symbol, type);
+
+			for (int i = 0; i < changes; i++) {
+
+				const int l = level(rng);
+
+				market_level(side, l, side[l].Price, qty(rng));
+
+			}
+
+		}
+
+	}
+
+	// a print at the inside, which it reduces
+
+	float trade(const double now_ms, std::mt19937 & rng) {
+
+		std::uniform_int_distribution<int>	volume(1, 20);
+		const int							type	= rng() & 1 ? SC_TS_BID : SC_TS_ASK;
+		const int							v		= volume(rng);
+		s_MarketDepthEntry &				inside	= market_side(symbol, type)[0];
+
+		market_trade(symbol, now_ms, inside.Price, v, type);
+
+		inside.Quantity = inside.Quantity > v ? inside.Quantity - v : 1 + v;	// refill
+
+		return inside.Price;
+
+	}
+
+};
+
+
+// one study's inputs and sheet cells
+
+struct bench_setup {
+
+	const char *	study;
+	const char *	inputs[8];
+
+};
+
+static const bench_setup setups[] = {
+
+	{ "order_flow",				{ "0=" X_SYMBOL, "1=bench", "2=order_flow" } },
+	{ "rotation",				{ "0=4", "1=4,8,16,32" } },
+	{ "two_leg_spread_vwap",	{ "0=" X_SYMBOL, "1=1", "2=" Y_SYMBOL, "3=-1", "4=500" } },
+	{ "vwap_single",			{ "4=500" } },
+	{ "m1_linreg",				{ "0=" Y_SYMBOL, "1=110", "2=5000", "3=45", "4=0.01", "5=0.999" } },
+	{ "spread_pricer",			{ "0=" X_SYMBOL ":1," Y_SYMBOL ":-40;" X_SYMBOL ":2," Y_SYMBOL ":-80", "1=20" } },
+	{ "spread_universe",		{ "0=" X_SYMBOL "," Y_SYMBOL, "1=1", "3=bench", "4=spread_universe" } },
+	{ "two_leg_spread",			{ "0=" X_SYMBOL, "1=1", "2=" Y_SYMBOL, "3=-40", "4=10" } },
+	{ "spread_offset",			{ "0=" Y_SYMBOL, "1=-40", "2=" X_SYMBOL, "3=1", "4=600" } },
+	{ "large_orders",			{ "0=bench", "1=large_orders", "2=195", "3=10", "4=10" } },
+	{ "icebergs",				{ "0=3" } },
+	{ "bond_rngs",				{ "1=" X_SYMBOL, "3=" X_SYMBOL "," Y_SYMBOL } },
+	{ "tpo_to_spreadsheet",		{ "0=bench", "1=tpo", "2=10", "3=1" } }
+
+};
+
+
+struct bench_options {
+
+	long long	prints		= 100000;
+	int			levels		= 10;
+	int			per_update	= 4;
+	int			changes		= 4;
+	int			warmup		= 1000;
+	double		step_ms		= 10;
+
+};
+
+
+static void bench(const bench_setup & b, const bench_options & o) {
+
+	// fresh market; sheets keep their handles, which the studies cache
+
+	sc_market.clear();
+	sc_market.max_depth_levels	= o.levels;
+	sc_market.echo				= false;
+
+	std::mt19937		rng(42);
+	synthetic_symbol	x;
+	synthetic_symbol	y;
+
+	x.open(X_SYMBOL, X_TICK, 5000, o.levels, rng);
+	y.open(Y_SYMBOL, Y_TICK, 110, o.levels, rng);
+
+	if (std::strcmp(b.study, "order_flow") == 0) {
+
+		// symbol block: symbol, trades, liq_levels, min_rotation, num_rotations
+
+		s_sc	sc;
+		void *	h = sc.GetSpreadsheetSheetHandleByName("bench", "order_flow", false);
+
+		sc.SetSheetCellAsString(h, 1, 0, X_SYMBOL);
+		sc.SetSheetCellAsDouble(h, 1, 1, 500);
+		sc.SetSheetCellAsDouble(h, 1, 2, o.levels < 10 ? o.levels : 10);
+		sc.SetSheetCellAsDouble(h, 1, 3, 8);
+		sc.SetSheetCellAsDouble(h, 1, 4, 10);
+
+	}
+
+	study_instance s;
+
+	s.open(find_study(b.study), X_SYMBOL, X_TICK);
+
+	for (const char * in : b.inputs)
+
+		if (in != NULL)
+
+			s.input(std::atoi(in), std::strchr(in, '=') + 1);
+
+	const long long						updates		= o.prints / o.per_update;
+	std::uniform_int_distribution<int>	walk(0, 99);
+	call_samples						samples;
+	double								now_ms		= 0;
+	float								high		= 0;
+	float								low			= 0;
+	long long							session		= 0;	// updates into the current profile
+
+	samples.ns.reserve(static_cast<size_t>(updates));
+
+	allocs		= 0;
+	alloc_bytes	= 0;
+
+	for (long long u = 0; u < o.warmup + updates; u++) {
+
+		now_ms += o.step_ms;
+
+		// market between calls
+
+		const int r = walk(rng);
+
+		if (r < 10)
+
+			x.move(r < 5 ? 1 : -1, rng);
+
+		if (r >= 90)
+
+			y.move(r < 95 ? 1 : -1, rng);
+
+		x.change(o.changes, rng);
+		y.change(o.changes, rng);
+
+		for (int i = 0; i < o.per_update; i++) {
+
+			const float p = x.trade(now_ms, rng);
+
+			high	= high == 0 || p > high ? p : high;
+			low		= low == 0 || p < low ? p : low;
+
+			if (i % 2 == 0)
+
+				y.trade(now_ms, rng);
+
+		}
+
+		s.sc.DailyHigh	= high;
+		s.sc.DailyLow	= low;
+
+		// a new profile every 30 minutes, the live one follows the prints
+
+		std::vector<n_ACSIL::s_StudyProfileInformation> & profiles = sc_market.profiles;
+
+		if (profiles.empty() || ++session * o.step_ms >= 1800000) {
+
+			if (profiles.size() >= MAX_PROFILES)
+
+				profiles.pop_back();
+
+			profiles.insert(profiles.begin(), n_ACSIL::s_StudyProfileInformation());
+
+			profiles[0].m_StartDateTime	= REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+			profiles[0].m_OpenPrice		= x.price_at(SC_TS_BID, 0);
+			profiles[0].m_HighestPrice	= profiles[0].m_OpenPrice;
+			profiles[0].m_LowestPrice	= profiles[0].m_OpenPrice;
+			session						= 0;
+
+		}
+
+		n_ACSIL::s_StudyProfileInformation & p = profiles[0];
+
+		p.m_LastPrice		= x.price_at(SC_TS_BID, 0);
+		p.m_HighestPrice	= p.m_LastPrice > p.m_HighestPrice ? p.m_LastPrice : p.m_HighestPrice;
+		p.m_LowestPrice		= p.m_LastPrice < p.m_LowestPrice ? p.m_LastPrice : p.m_LowestPrice;
+		p.m_EndDateTime		= REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+		p.m_Volume			+= o.per_update * 10;
+		p.m_NumberOfTrades	+= o.per_update;
+
+		// the call
+
+		const bool measured = u >= o.warmup;
+
+		counting = measured;
+
+		const call_clock::time_point t0 = call_clock::now();
+
+		s.call(now_ms, u == 0);
+
+		const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(call_clock::now() - t0).count();
+
+		counting = false;
+
+		if (measured)
+
+			samples.record(ns);
+
+	}
+
+	s.close();
+
+	const double n = updates > 0 ? static_cast<double>(updates) : 1;
+
+	printf("%-20s %9lld %10.0f %8lld %9.4f %10.2f %9lld %9lld %9lld %10lld\n",
+		b.study, updates, samples.mean(), allocs, allocs / n, alloc_bytes / n,
+		samples.percentile(0.50), samples.percentile(0.99), samples.percentile(0.999), samples.peak()
+	);
+
+	fflush(stdout);
+
+}
+
+
+static int usage() {
+
+	fprintf(stderr, "usage: bench [-p prints] [-l levels] [-u prints_per_update] [-c changes] [-w warmup] [-m ms] [study ...]\n");
+
+	return 2;
+
+}
+
+
+int main(int argc, char ** argv) {
+
+	bench_options	o;
+	int				i	= 1;
+
+	for (; i < argc && argv[i][0] == '-'; i += 2) {
+
+		if (i + 1 >= argc)
+
+			return usage();
+
+		const double v = std::atof(argv[i + 1]);
+
+		switch (argv[i][1]) {
+
+			case 'p': o.prints		= static_cast<long long>(v);	break;
+			case 'l': o.levels		= static_cast<int>(v);			break;
+			case 'u': o.per_update	= static_cast<int>(v);			break;
+			case 'c': o.changes		= static_cast<int>(v);			break;
+			case 'w': o.warmup		= static_cast<int>(v);			break;
+			case 'm': o.step_ms		= v;							break;
+			default: return usage();
+
+		}
+
+	}
+
+	if (o.prints <= 0 || o.levels <= 0 || o.per_update <= 0 || o.changes < 0 || o.warmup < 0 || o.step_ms <= 0)
+
+		return usage();
+
+	printf("%lld prints, %d levels, %d prints and %d depth changes per update, %d warmup updates\n\n",
+		o.prints, o.levels, o.per_update, o.changes, o.warmup
+	);
+
+	printf("%-20s %9s %10s %8s %9s %10s %9s %9s %9s %10s\n", "study", "updates", "ns/update", "allocs", "allocs/u", "bytes/u", "p50", "p99", "p999", "max");
+
+	for (const bench_setup & b : setups) {
+
+		bool selected = i == argc;
+
+		for (int j = i; j < argc; j++)
+
+			selected = selected || std::strcmp(argv[j], b.study) == 0;
+
+		if (selected)
+
+			bench(b, o);
+
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,332 @@
+// shared by replay.cpp, bench.cpp and rotation_test.cpp: the table of
+// exported studies, a study instance that owns its s_sc, the market feed
+// into sc_market, event file lines and call latency samples.
+
+#pragma once
+
+#include "sierrachart.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+
+// exported by user.cpp
+
+extern "C" {
+
+	void scsf_order_flow(SCStudyInterfaceRef sc);
+	void scsf_rotation(SCStudyInterfaceRef sc);
+	void scsf_two_leg_spread_vwap(SCStudyInterfaceRef sc);
+	void scsf_vwap_single(SCStudyInterfaceRef sc);
+	void scsf_m1_linreg(SCStudyInterfaceRef sc);
+	void scsf_spread_pricer(SCStudyInterfaceRef sc);
+	void scsf_spread_universe(SCStudyInterfaceRef sc);
+	void scsf_two_leg_spread(SCStudyInterfaceRef sc);
+	void scsf_spread_offset(SCStudyInterfaceRef sc);
+	void scsf_large_orders(SCStudyInterfaceRef sc);
+	void scsf_icebergs(SCStudyInterfaceRef sc);
+	void scsf_bond_rngs(SCStudyInterfaceRef sc);
+	void scsf_tpo_to_spreadsheet(SCStudyInterfaceRef sc);
+
+}
+
+typedef void (*study_function)(SCStudyInterfaceRef);
+
+struct study_entry {
+
+	const char *	name;
+	study_function	f;
+
+};
+
+inline const study_entry studies[] = {
+
+	{ "order_flow",				scsf_order_flow				},
+	{ "rotation",				scsf_rotation				},
+	{ "two_leg_spread_vwap",	scsf_two_leg_spread_vwap	},
+	{ "vwap_single",			scsf_vwap_single			},
+	{ "m1_linreg",				scsf_m1_linreg				},
+	{ "spread_pricer",			scsf_spread_pricer			},
+	{ "spread_universe",		scsf_spread_universe		},
+	{ "two_leg_spread",			scsf_two_leg_spread			},
+	{ "spread_offset",			scsf_spread_offset			},
+	{ "large_orders",			scsf_large_orders			},
+	{ "icebergs",				scsf_icebergs				},
+	{ "bond_rngs",				scsf_bond_rngs				},
+	{ "tpo_to_spreadsheet",		scsf_tpo_to_spreadsheet		}
+
+};
+
+inline const study_entry * find_study(const char * name) {
+
+	for (const study_entry & e : studies)
+
+		if (std::strcmp(e.name, name) == 0)
+
+			return &e;
+
+	return NULL;
+
+}
+
+
+// 2024-01-02, so sheet retries and iceberg expiry see realistic day counts
+
+#define REPLAY_EPOCH_DAYS	45293.0
+#define MS_PER_DAY			86400000.0
+
+
+// market feed. each symbol's time and sales is bounded like sierra chart's,
+// dropping the older half when full, and sequence numbers keep increasing.
+
+inline size_t		tas_max		= 1 << 20;
+inline unsigned int	tas_seq		= 0;
+
+inline void market_tick_size(const char * symbol, const float tick_size) {
+
+	sc_market.at(symbol).tick_size = tick_size;
+
+}
+
+inline void market_trade(const char * symbol, const double now_ms, const float price, const unsigned int volume, const int type) {
+
+	sc_symbol_data &				d	= sc_market.at(symbol);
+	std::vector<s_TimeAndSales> &	tas	= d.tas;
+
+	if (tas.size() >= tas_max)
+
+		tas.erase(tas.begin(), tas.begin() + tas.size() / 2);
+
+	s_TimeAndSales r;
+
+	r.DateTime	= REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+	r.Price		= price;
+	r.Bid		= d.bids.empty() ? price : d.bids[0].Price;
+	r.Ask		= d.asks.empty() ? price : d.asks[0].Price;
+	r.Volume	= volume;
+	r.Sequence	= ++tas_seq;
+	r.Type		= type;
+
+	tas.push_back(r);
+
+}
+
+// one side of the book, inside first
+
+inline std::vector<s_MarketDepthEntry> & market_side(const char * symbol, const int type) {
+
+	sc_symbol_data & d = sc_market.at(symbol);
+
+	return type == SC_TS_BID ? d.bids : d.asks;
+
+}
+
+inline void market_level(std::vector<s_MarketDepthEntry> & side, const size_t level, const float price, const int qty) {
+
+	if (side.size() <= level)
+
+		side.resize(level + 1);
+
+	s_MarketDepthEntry & e = side[level];
+
+	e.Price			= price;
+	e.AdjustedPrice	= price;
+	e.Quantity		= qty;
+	e.NumOrders		= qty > 0 ? 1 : 0;
+
+}
+
+
+// one chart's study: its own s_sc, persistent storage and bar arrays
+
+struct study_instance {
+
+	const study_entry *	study	= NULL;
+	s_sc				sc;
+
+	void open(const study_entry * e, const char * symbol, const float tick_size, const int bars = 1) {
+
+		study			= e;
+		sc.SetDefaults	= 1;
+
+		study->f(sc);
+
+		sc.SetDefaults	= 0;
+		sc.Symbol		= symbol;
+		sc.TickSize		= tick_size;
+
+		sc.resize(bars);
+
+		if (sc_market.find(symbol) == NULL || sc_market.at(symbol).tick_size == 0)
+
+			market_tick_size(symbol, tick_size);
+
+	}
+
+	void input(const int i, const char * value) { sc.Input[i].SetString(value); }
+
+	void call(const double now_ms, const bool full = false) {
+
+		const double now = REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+
+		sc.CurrentSystemDateTime	= now;
+		sc.CurrentSystemDateTimeMS	= now;
+		sc.IsFullRecalculation		= full;
+
+		study->f(sc);
+
+	}
+
+	// frees the study's persistent state, as when the study is removed
+
+	void close() {
+
+		sc.LastCallToFunction = 1;
+
+		study->f(sc);
+
+		sc.LastCallToFunction = 0;
+
+	}
+
+};
+
+
+// applies one line of an event file, see replay.cpp; returns 1 for an
+// update, 0 otherwise, -1 on a bad line
+
+inline int replay_event(char * line, study_instance & s, double & now_ms) {
+
+	char * f[2048];
+	int    n = 0;
+
+	for (char * t = std::strtok(line, ",\r\n"); t != NULL && n < 2048; t = std::strtok(NULL, ",\r\n"))
+
+		f[n++] = t;
+
+	if (n < 2)
+
+		return -1;
+
+	now_ms = std::atof(f[0]);
+
+	switch (*f[1]) {
+
+		case 'T':
+
+			if (n < 6)
+
+				return -1;
+
+			market_trade(f[2], now_ms, std::strtof(f[3], NULL), std::strtoul(f[4], NULL, 10), *f[5] == 'B' ? SC_TS_BID : SC_TS_ASK);
+
+			return 0;
+
+		case 'D': {
+
+			if (n < 4 || (n - 4) % 2 != 0)
+
+				return -1;
+
+			std::vector<s_MarketDepthEntry> & side = market_side(f[2], *f[3] == 'B' ? SC_TS_BID : SC_TS_ASK);
+
+			side.clear();
+
+			for (int i = 4; i < n; i += 2)
+
+				market_level(side, side.size(), std::strtof(f[i], NULL), std::atoi(f[i + 1]));
+
+			return 0;
+
+		}
+
+		case 'H':
+
+			if (n < 4)
+
+				return -1;
+
+			s.sc.DailyHigh	= std::strtof(f[2], NULL);
+			s.sc.DailyLow	= std::strtof(f[3], NULL);
+
+			return 0;
+
+		case 'P': {
+
+			if (n < 11)
+
+				return -1;
+
+			std::vector<n_ACSIL::s_StudyProfileInformation> & profiles = sc_market.profiles;
+
+			if (*f[2] == 'N' || profiles.empty()) {
+
+				profiles.insert(profiles.begin(), n_ACSIL::s_StudyProfileInformation());
+
+				profiles[0].m_StartDateTime = REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+
+			}
+
+			n_ACSIL::s_StudyProfileInformation & p = profiles[0];
+
+			p.m_EndDateTime			= REPLAY_EPOCH_DAYS + now_ms / MS_PER_DAY;
+			p.m_OpenPrice			= std::strtof(f[3], NULL);
+			p.m_HighestPrice		= std::strtof(f[4], NULL);
+			p.m_LowestPrice			= std::strtof(f[5], NULL);
+			p.m_LastPrice			= std::strtof(f[6], NULL);
+			p.m_TPOPOCPrice			= std::strtof(f[7], NULL);
+			p.m_VolumePOCPrice		= p.m_TPOPOCPrice;
+			p.m_TPOValueAreaHigh	= std::strtof(f[8], NULL);
+			p.m_VolumeValueAreaHigh	= p.m_TPOValueAreaHigh;
+			p.m_TPOValueAreaLow		= std::strtof(f[9], NULL);
+			p.m_VolumeValueAreaLow	= p.m_TPOValueAreaLow;
+			p.m_Volume				= std::atof(f[10]);
+
+			return 0;
+
+		}
+
+		case 'U':
+
+			return 1;
+
+	}
+
+	return -1;
+
+}
+
+
+// per call wall time
+
+typedef std::chrono::steady_clock call_clock;
+
+struct call_samples {
+
+	std::vector<long long>	ns;
+	long long				total	= 0;
+
+	void record(const long long t) { ns.push_back(t); total += t; }
+
+	// nearest rank; reorders the samples
+
+	long long percentile(const double q) {
+
+		if (ns.empty())
+
+			return 0;
+
+		const size_t i = static_cast<size_t>(q * (ns.size() - 1) + 0.5);
+
+		std::nth_element(ns.begin(), ns.begin() + i, ns.end());
+
+		return ns[i];
+
+	}
+
+	long long peak() const { return ns.empty() ? 0 : *std::max_element(ns.begin(), ns.end()); }
+
+	double mean() const { return ns.empty() ? 0 : static_cast<double>(total) / ns.size(); }
+
+};
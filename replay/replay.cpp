@@ -0,0 +1,284 @@
+// replays a recorded event file into one study of user.cpp and reports the
+// per call latency, then the study's subgraphs and, with -w, its sheets.
+//
+//		replay [options] study events.csv
+//
+//		-s SYMBOL					chart symbol (ESZ4)
+//		-t TICK						chart tick size (0.25)
+//		-k SYMBOL=TICK				tick size of another symbol; 0, i.e. unknown, until set
+//		-i N=VALUE					study input N
+//		-c FILE|SHEET|COL|ROW=VALUE	sheet cell, a number when VALUE parses as one
+//		-q							do not print the message log
+//		-w							print every sheet cell at the end
+//		-n							print the study's inputs and exit
+//
+// one event per line, times in milliseconds from the session start:
+//
+//		ms,T,SYMBOL,PRICE,VOLUME,B|A	trade at the bid or ask
+//		ms,D,SYMBOL,B|A,PRICE,QTY,...	one side of the book, inside first
+//		ms,H,HIGH,LOW					daily high and low of the chart symbol
+//		ms,P,N|L,OPEN,HIGH,LOW,LAST,POC,VAH,VAL,VOLUME
+//										a new study profile, or the live one updated
+//		ms,U							study update
+//
+// blank lines and lines starting with '#' are skipped. e.g. with sample.csv:
+//
+//		replay -q -k NQZ4=0.25 -i 0=ESZ4 -i 1=1 -i 2=NQZ4 -i 3=-1 -i 4=10 two_leg_spread sample.csv
+//		replay -q -w -c "f|s|1|0=ESZ4" -c "f|s|1|1=100" -c "f|s|1|2=5" -c "f|s|1|3=4" -c "f|s|1|4=3" -i 0=ESZ4 -i 1=f -i 2=s order_flow sample.csv
+
+#include "harness.h"
+
+#include <fstream>
+#include <string>
+
+
+static int usage() {
+
+	fprintf(stderr, "usage: replay [-s symbol] [-t tick] [-k symbol=tick] [-i n=value] [-c file|sheet|col|row=value] [-q] [-w] [-n] study [events.csv]\n");
+
+	return 2;
+
+}
+
+
+// "FILE|SHEET|COL|ROW=VALUE"
+
+static bool set_cell(const char * arg) {
+
+	const std::string	a(arg);
+	const size_t		eq	= a.find('=');
+	const size_t		p1	= a.find('|');
+	const size_t		p2	= p1 == std::string::npos ? p1 : a.find('|', p1 + 1);
+	const size_t		p3	= p2 == std::string::npos ? p2 : a.find('|', p2 + 1);
+
+	if (eq == std::string::npos || p3 == std::string::npos || p3 > eq)
+
+		return false;
+
+	const std::string	file	= a.substr(0, p1);
+	const std::string	sheet	= a.substr(p1 + 1, p2 - p1 - 1);
+	const int			col		= std::atoi(a.c_str() + p2 + 1);
+	const int			row		= std::atoi(a.c_str() + p3 + 1);
+	const char *		value	= a.c_str() + eq + 1;
+	char *				end		= NULL;
+	const double		d		= std::strtod(value, &end);
+	s_sc				sc;
+	void *				h		= sc.GetSpreadsheetSheetHandleByName(file.c_str(), sheet.c_str(), false);
+
+	if (*value != 0 && *end == 0)
+
+		sc.SetSheetCellAsDouble(h, col, row, d);
+
+	else
+
+		sc.SetSheetCellAsString(h, col, row, value);
+
+	return true;
+
+}
+
+
+int main(int argc, char ** argv) {
+
+	const char *				symbol		= "ESZ4";
+	float						tick_size	= 0.25f;
+	bool						sheets		= false;
+	bool						names		= false;
+	std::vector<const char *>	inputs;
+	int							i			= 1;
+
+	for (; i < argc && argv[i][0] == '-'; i++) {
+
+		const char o = argv[i][1];
+
+		if (o == 'q') {
+
+			sc_market.echo = false;
+
+			continue;
+
+		}
+
+		if (o == 'w' || o == 'n') {
+
+			(o == 'w' ? sheets : names) = true;
+
+			continue;
+
+		}
+
+		if (i + 1 >= argc)
+
+			return usage();
+
+		const char * v = argv[++i];
+
+		if (o == 's')
+
+			symbol = v;
+
+		else if (o == 't')
+
+			tick_size = std::strtof(v, NULL);
+
+		else if (o == 'i')
+
+			inputs.push_back(v);
+
+		else if (o == 'k') {
+
+			const char * eq = std::strchr(v, '=');
+
+			if (eq == NULL)
+
+				return usage();
+
+			market_tick_size(std::string(v, eq).c_str(), std::strtof(eq + 1, NULL));
+
+		} else if (o == 'c') {
+
+			if (!set_cell(v))
+
+				return usage();
+
+		} else
+
+			return usage();
+
+	}
+
+	if (argc - i != (names ? 1 : 2))
+
+		return usage();
+
+	const study_entry * e = find_study(argv[i]);
+
+	if (e == NULL) {
+
+		fprintf(stderr, "unknown study %s; one of:", argv[i]);
+
+		for (const study_entry & s : studies)
+
+			fprintf(stderr, " %s", s.name);
+
+		fprintf(stderr, "\n");
+
+		return 2;
+
+	}
+
+	study_instance s;
+
+	s.open(e, symbol, tick_size);
+
+	if (names) {
+
+		for (int j = 0; j < SC_INPUTS_AVAILABLE; j++)
+
+			if (s.sc.Input[j].Name.GetLength() > 0)
+
+				printf("  %d %s\n", j, s.sc.Input[j].Name.GetChars());
+
+		return 0;
+
+	}
+
+	std::ifstream events(argv[i + 1]);
+
+	if (!events) {
+
+		fprintf(stderr, "cannot open %s\n", argv[i + 1]);
+
+		return 1;
+
+	}
+
+	for (const char * in : inputs) {
+
+		const char * eq = std::strchr(in, '=');
+
+		if (eq == NULL)
+
+			return usage();
+
+		s.input(std::atoi(in), eq + 1);
+
+	}
+
+	call_samples	samples;
+	std::string		line;
+	double			now_ms	= 0;
+	int				number	= 0;
+
+	while (std::getline(events, line)) {
+
+		number++;
+
+		if (line.empty() || line[0] == '#' || line[0] == '\r')
+
+			continue;
+
+		const int r = replay_event(&line[0], s, now_ms);
+
+		if (r < 0) {
+
+			fprintf(stderr, "%s:%d: bad event\n", argv[i + 1], number);
+
+			return 1;
+
+		}
+
+		if (r == 0)
+
+			continue;
+
+		const call_clock::time_point t0 = call_clock::now();
+
+		s.call(now_ms, samples.ns.empty());
+
+		samples.record(std::chrono::duration_cast<std::chrono::nanoseconds>(call_clock::now() - t0).count());
+
+	}
+
+	const size_t calls = samples.ns.size();
+
+	printf("%s: %zu updates, mean %.0f ns, p50 %lld ns, p99 %lld ns, p999 %lld ns, max %lld ns\n",
+		e->name, calls, samples.mean(),
+		samples.percentile(0.50), samples.percentile(0.99), samples.percentile(0.999), samples.peak()
+	);
+
+	// last values of the named subgraphs
+
+	for (int j = 0; j < SC_SUBGRAPHS_AVAILABLE; j++) {
+
+		SCSubgraph & g = s.sc.Subgraph[j];
+
+		if (g.Name.GetLength() > 0)
+
+			printf("  %-16s %g\n", g.Name.GetChars(), g[s.sc.Index]);
+
+	}
+
+	if (sheets) {
+
+		for (const auto & sh : sc_sheets)
+
+			for (const auto & c : sh.second.cells) {
+
+				if (c.second.is_string)
+
+					printf("  %s!%d,%d %s\n", sh.first.c_str(), c.first.first, c.first.second, c.second.s.c_str());
+
+				else
+
+					printf("  %s!%d,%d %g\n", sh.first.c_str(), c.first.first, c.first.second, c.second.d);
+
+			}
+
+	}
+
+	s.close();
+
+	return 0;
+
+}
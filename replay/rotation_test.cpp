@@ -0,0 +1,212 @@
+// checks multi_rotation against one rotation_tracker<rotation_stats> per
+// threshold on the chart symbol's trades of an event file, after every
+// trade, then replays the file through scsf_rotation and checks that each
+// thresholds subgraph matches the min_rotation one at the same threshold
+// on every update, also after the thresholds were cleared for a while and
+// set again. exits 1 on the first mismatch.
+//
+//		rotation_test [events.csv]		(sample.csv)
+//
+// user.cpp is compiled into this file so the trackers can be driven
+// directly.
+
+#include "harness.h"
+
+#include "../user.cpp"
+
+#include <fstream>
+#include <string>
+
+
+#define TEST_SYMBOL "ESZ4"
+#define TEST_TICK	0.25f
+
+static const int thresholds[MAX_THRESHOLDS] = { 1, 2, 3, 4, 5, 6, 8, 12 };
+
+
+static int fail(const char * what, const int j, const int i, const long long a, const long long b) {
+
+	fprintf(stderr, "%s differs for threshold %d at %d: tracker %lld, multi %lld\n", what, thresholds[j], i, a, b);
+
+	return 1;
+
+}
+
+
+// the same rotations, trade by trade
+
+static int check_trackers(const std::vector<int> & prices) {
+
+	rotation_tracker<rotation_stats>	trackers[MAX_THRESHOLDS];
+	multi_rotation						multi;
+	int									rotations	= 0;
+
+	for (int j = 0; j < MAX_THRESHOLDS; j++)
+
+		trackers[j].reset(thresholds[j]);
+
+	multi.reset(thresholds, MAX_THRESHOLDS);
+
+	for (int i = 0; i < static_cast<int>(prices.size()); i++) {
+
+		multi.update(prices[i]);
+
+		for (int j = 0; j < MAX_THRESHOLDS; j++) {
+
+			rotation_tracker<rotation_stats> &	t	= trackers[j];
+			const rotation_stats &				s	= t.s;
+
+			t.update(prices[i], 1, SC_TS_ASK);
+
+			if (t.side != multi.side[j])				return fail("side", j, i, t.side, multi.side[j]);
+			if (t.start() != multi.start(j))			return fail("start", j, i, t.start(), multi.start(j));
+			if (t.length != multi.length[j])			return fail("length", j, i, t.length, multi.length[j]);
+			if (s.count != multi.count[j])				return fail("count", j, i, s.count, multi.count[j]);
+			if (s.len_sum != multi.len_sum[j])			return fail("len_sum", j, i, s.len_sum, multi.len_sum[j]);
+			if (s.len_max != multi.len_max[j])			return fail("len_max", j, i, s.len_max, multi.len_max[j]);
+
+		}
+
+	}
+
+	for (int j = 0; j < MAX_THRESHOLDS; j++)
+
+		rotations += trackers[j].s.count;
+
+	printf("trackers: %zu trades, %d rotations over %d thresholds, multi_rotation matches\n", prices.size(), rotations, MAX_THRESHOLDS);
+
+	return 0;
+
+}
+
+
+// scsf_rotation with min_rotation and thresholds set, so its avg / max
+// subgraphs come from the tracker and avg_j / max_j from multi_rotation.
+// thresholds are cleared for updates [off, on), which are not compared.
+
+static int check_study(const char * path, const int min_rotation, const char * list, const int j, const int off = -1, const int on = -1) {
+
+	std::ifstream events(path);
+
+	sc_market.clear();
+
+	study_instance s;
+
+	s.open(find_study("rotation"), TEST_SYMBOL, TEST_TICK);
+
+	s.input(0, std::to_string(min_rotation).c_str());
+	s.input(1, list);
+
+	std::string	line;
+	double		now_ms	= 0;
+	int			updates	= 0;
+
+	while (std::getline(events, line)) {
+
+		if (line.empty() || line[0] == '#' || line[0] == '\r')
+
+			continue;
+
+		if (replay_event(&line[0], s, now_ms) != 1)
+
+			continue;
+
+		if (updates == off || updates == on)
+
+			s.input(1, updates == off ? "" : list);
+
+		s.call(now_ms, updates == 0);
+
+		if (updates >= off && updates < on) {
+
+			updates++;
+
+			continue;
+
+		}
+
+		const float avg		= s.sc.Subgraph[2][s.sc.Index];
+		const float max		= s.sc.Subgraph[3][s.sc.Index];
+		const float avg_j	= s.sc.Subgraph[4 + 2 * j][s.sc.Index];
+		const float max_j	= s.sc.Subgraph[5 + 2 * j][s.sc.Index];
+
+		if (avg != avg_j || max != max_j) {
+
+			fprintf(stderr, "rotation %d vs thresholds %s at update %d: avg %g / %g, max %g / %g\n", min_rotation, list, updates, avg, avg_j, max, max_j);
+
+			return 1;
+
+		}
+
+		updates++;
+
+	}
+
+	s.close();
+
+	printf("study: %d updates, min_rotation %d matches avg_%d / max_%d of \"%s\"", updates, min_rotation, j, j, list);
+
+	if (off >= 0)
+
+		printf(", cleared for updates %d to %d", off, on - 1);
+
+	printf("\n");
+
+	return 0;
+
+}
+
+
+int main(int argc, char ** argv) {
+
+	const char * path = argc > 1 ? argv[1] : "sample.csv";
+
+	std::ifstream		events(path);
+	std::string			line;
+	std::vector<int>	prices;
+
+	if (!events) {
+
+		fprintf(stderr, "cannot open %s\n", path);
+
+		return 1;
+
+	}
+
+	while (std::getline(events, line)) {
+
+		// ms,T,SYMBOL,PRICE,VOLUME,B|A
+
+		const size_t t = line.find(",T," TEST_SYMBOL ",");
+
+		if (t != std::string::npos)
+
+			prices.push_back(to_ticks(std::strtof(line.c_str() + t + sizeof(",T," TEST_SYMBOL ",") - 1, NULL), TEST_TICK));
+
+	}
+
+	if (prices.empty()) {
+
+		fprintf(stderr, "no %s trades in %s\n", TEST_SYMBOL, path);
+
+		return 1;
+
+	}
+
+	if (check_trackers(prices) != 0)
+
+		return 1;
+
+	sc_market.echo = false;
+
+	if (
+		check_study(path, 4, "2,4,8", 1)			!= 0 ||
+		check_study(path, 3, "3", 0)				!= 0 ||
+		check_study(path, 4, "2,4,8", 1, 50, 120)	!= 0
+	)
+
+		return 1;
+
+	return 0;
+
+}
@@ -0,0 +1,584 @@
+// stand-in for sierra chart's sierrachart.h, used to build user.cpp on linux
+// and drive its studies from replay.cpp and bench.cpp. it is not a copy of
+// the acsil header: only the types and calls user.cpp uses, with the same
+// names and call shapes. market data, spreadsheets and study profiles live
+// in process-wide tables (sc_market, sc_sheets) that the drivers fill
+// between study calls; nothing here allocates on a study's steady-state
+// path, so allocation counts measured around a call belong to the study.
+
+#pragma once
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// windows.h min / max, which user.cpp relies on
+
+inline int		min(const int a, const int b) { return a < b ? a : b; }
+inline int		max(const int a, const int b) { return a > b ? a : b; }
+inline double	min(const double a, const double b) { return a < b ? a : b; }
+inline double	max(const double a, const double b) { return a > b ? a : b; }
+
+#define SCDLLName(name)
+#define SCSFExport extern "C" void
+
+enum { SC_TS_MARKER, SC_TS_BID, SC_TS_ASK, SC_TS_BIDASKVALUES };
+enum { DRAWSTYLE_IGNORE, DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY, DRAWSTYLE_LINE };
+enum { LL_DISPLAY_NAME = 1, LL_VALUE_ALIGN_VALUES_SCALE = 2, LL_DISPLAY_VALUE = 4, LL_DISPLAY_CUSTOM_VALUE_AT_Y = 8 };
+enum SymbolDataValuesEnum { SYMBOL_DATA_TICK_SIZE = 1 };
+
+#define SC_SUBGRAPHS_AVAILABLE	60
+#define SC_INPUTS_AVAILABLE		128
+
+
+class SCString {
+
+	std::string s;
+
+public:
+
+	SCString() {}
+
+	SCString(const char * c) : s(c != NULL ? c : "") {}
+
+	SCString & operator = (const char * c) { s.assign(c != NULL ? c : ""); return *this; }
+
+	// formats into the existing buffer
+
+	SCString & Format(const char * format, ...) {
+
+		char	buf[512];
+		va_list	args;
+
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+
+		s.assign(buf);
+
+		return *this;
+
+	}
+
+	int Compare(const char * o) const { return std::strcmp(s.c_str(), o != NULL ? o : ""); }
+
+	int Compare(const SCString & o) const { return std::strcmp(s.c_str(), o.s.c_str()); }
+
+	const char * GetChars() const { return s.c_str(); }
+
+	int GetLength() const { return static_cast<int>(s.size()); }
+
+	operator const char * () const { return s.c_str(); }
+
+};
+
+
+// days since 1899-12-30, as in sierra chart
+
+struct SCDateTime {
+
+	double v = 0;
+
+	SCDateTime() {}
+
+	SCDateTime(const double d) : v(d) {}
+
+	double GetAsDouble() const { return v; }
+
+	operator double () const { return v; }
+
+};
+
+typedef SCDateTime SCDateTimeMS;
+
+
+struct s_TimeAndSales {
+
+	SCDateTime		DateTime;
+	float			Price		= 0;
+	float			Bid			= 0;
+	float			Ask			= 0;
+	unsigned int	Volume		= 0;
+	unsigned int	Sequence	= 0;
+	int				Type		= SC_TS_MARKER;
+
+};
+
+
+// a view of the symbol's records in sc_market, valid until the next call
+
+class c_SCTimeAndSalesArray {
+
+public:
+
+	const s_TimeAndSales *	data	= NULL;
+	int						size	= 0;
+
+	int Size() const { return size; }
+
+	const s_TimeAndSales & operator [] (const int i) const { return data[i]; }
+
+};
+
+
+struct s_MarketDepthEntry {
+
+	float	Price			= 0;
+	float	AdjustedPrice	= 0;
+	int		Quantity		= 0;
+	int		NumOrders		= 0;
+
+};
+
+
+// inputs keep the text and the number they were last set from
+
+struct SCInput {
+
+	SCString	Name;
+	std::string	text;
+	double		value	= 0;
+
+	void SetString(const char * s) { text.assign(s); value = std::atof(s); }
+
+	const char * GetString() const { return text.c_str(); }
+
+	void SetInt(const int i) { value = i; }
+
+	int GetInt() const { return static_cast<int>(value); }
+
+	void SetFloat(const float f) { value = f; }
+
+	float GetFloat() const { return static_cast<float>(value); }
+
+	void SetYesNo(const int b) { value = b != 0; }
+
+	int GetYesNo() const { return value != 0; }
+
+};
+
+typedef SCInput & SCInputRef;
+
+
+struct SCFloatArray {
+
+	std::vector<float> v;
+
+	float & operator [] (const int i) { return v[i]; }
+
+};
+
+
+struct SCSubgraph {
+
+	SCString		Name;
+	int				DrawStyle	= DRAWSTYLE_LINE;
+	unsigned int	LineLabel	= 0;
+	SCFloatArray	Data;
+	SCFloatArray	Arrays[4];
+
+	float & operator [] (const int i) { return Data[i]; }
+
+};
+
+
+namespace n_ACSIL {
+
+	struct s_StudyProfileInformation {
+
+		SCDateTime	m_StartDateTime;
+		int			m_NumberOfTrades						= 0;
+		double		m_Volume								= 0;
+		double		m_BidVolume								= 0;
+		double		m_AskVolume								= 0;
+		int			m_TotalTPOCount							= 0;
+		float		m_OpenPrice								= 0;
+		float		m_HighestPrice							= 0;
+		float		m_LowestPrice							= 0;
+		float		m_LastPrice								= 0;
+		float		m_TPOMidpointPrice						= 0;
+		float		m_TPOMean								= 0;
+		float		m_TPOStdDev								= 0;
+		float		m_TPOErrorOfMean						= 0;
+		float		m_TPOPOCPrice							= 0;
+		float		m_TPOValueAreaHigh						= 0;
+		float		m_TPOValueAreaLow						= 0;
+		int			m_TPOCountAbovePOC						= 0;
+		int			m_TPOCountBelowPOC						= 0;
+		float		m_VolumeMidpointPrice					= 0;
+		float		m_VolumePOCPrice						= 0;
+		float		m_VolumeValueAreaHigh					= 0;
+		float		m_VolumeValueAreaLow					= 0;
+		double		m_VolumeAbovePOC						= 0;
+		double		m_VolumeBelowPOC						= 0;
+		double		m_POCAboveBelowVolumeImbalancePercent	= 0;
+		double		m_VolumeAboveLastPrice					= 0;
+		double		m_VolumeBelowLastPrice					= 0;
+		double		m_BidVolumeAbovePOC						= 0;
+		double		m_BidVolumeBelowPOC						= 0;
+		double		m_AskVolumeAbovePOC						= 0;
+		double		m_AskVolumeBelowPOC						= 0;
+		double		m_VolumeTimesPriceInTicks				= 0;
+		double		m_TradesTimesPriceInTicks				= 0;
+		double		m_TradesTimesPriceSquaredInTicks		= 0;
+		float		m_IBRHighPrice							= 0;
+		float		m_IBRLowPrice							= 0;
+		float		m_OpeningRangeHighPrice					= 0;
+		float		m_OpeningRangeLowPrice					= 0;
+		float		m_VolumeWeightedAveragePrice			= 0;
+		int			m_MaxTPOBlocksCount						= 0;
+		int			m_TPOCountMaxDigits						= 0;
+		int			m_DisplayIndependentColumns				= 0;
+		int			m_EveningSession						= 0;
+		float		m_AverageSubPeriodRange					= 0;
+		float		m_RotationFactor						= 0;
+		double		m_VolumeAboveTPOPOC						= 0;
+		double		m_VolumeBelowTPOPOC						= 0;
+		SCDateTime	m_EndDateTime;
+		int			m_BeginIndex							= 0;
+		int			m_EndIndex								= 0;
+
+	};
+
+}
+
+
+// market data the drivers feed: per symbol time and sales and the current
+// depth of each side, inside first
+
+struct sc_symbol_data {
+
+	float								tick_size	= 0;
+	std::vector<s_TimeAndSales>			tas;
+	std::vector<s_MarketDepthEntry>		bids;
+	std::vector<s_MarketDepthEntry>		asks;
+
+};
+
+struct sc_market_data {
+
+	std::map<std::string, sc_symbol_data, std::less<>>		symbols;
+	int														max_depth_levels	= 1000;
+	std::vector<n_ACSIL::s_StudyProfileInformation>			profiles;	// newest first
+	long long												messages	= 0;
+	bool													echo		= true;	// print the message log
+
+	// the last symbol found. studies look it up once per depth level, and a
+	// map lookup each time would be most of what a benchmark measures.
+
+	mutable std::string				last_symbol;
+	mutable const sc_symbol_data *	last		= NULL;
+
+	sc_symbol_data & at(const char * symbol) { return symbols[symbol]; }
+
+	const sc_symbol_data * find(const char * symbol) const {
+
+		if (last != NULL && last_symbol.compare(symbol) == 0)
+
+			return last;
+
+		auto it = symbols.find(symbol);
+
+		if (it == symbols.end())
+
+			return NULL;
+
+		last_symbol.assign(symbol);
+
+		return last = &it->second;
+
+	}
+
+	void clear() {
+
+		symbols.clear();
+		profiles.clear();
+
+		last = NULL;
+
+	}
+
+};
+
+inline sc_market_data sc_market;
+
+
+// in-memory spreadsheets, one per "file|sheet"
+
+struct sc_sheet_cell {
+
+	bool		is_string	= false;
+	double		d			= 0;
+	std::string	s;
+
+};
+
+struct sc_sheet {
+
+	std::map<std::pair<int, int>, sc_sheet_cell>	cells;	// (col, row)
+
+};
+
+inline std::map<std::string, sc_sheet, std::less<>> sc_sheets;
+
+
+struct s_sc {
+
+	int				SetDefaults				= 0;
+	int				AutoLoop				= 0;
+	int				UsesMarketDepthData		= 0;
+	int				HideStudy				= 0;
+	int				GraphRegion				= 0;
+	int				Index					= 0;
+	int				ArraySize				= 1;
+	int				LastCallToFunction		= 0;
+	int				IsFullRecalculation		= 0;
+	int				UpdateStartIndex		= 0;
+	int				StudyGraphInstanceID	= 1;
+	int				ChartNumber				= 1;
+
+	SCString		GraphName;
+	SCString		Symbol;
+	float			TickSize				= 0.25f;
+	float			RealTimePriceMultiplier	= 1;
+	float			DailyHigh				= 0;
+	float			DailyLow				= 0;
+	SCDateTimeMS	CurrentSystemDateTimeMS;
+	SCDateTime		CurrentSystemDateTime;
+
+	SCInput			Input[SC_INPUTS_AVAILABLE];
+	SCSubgraph		Subgraph[SC_SUBGRAPHS_AVAILABLE];
+
+	std::map<int, int>		persistent_ints;
+	std::map<int, float>	persistent_floats;
+	std::map<int, double>	persistent_doubles;
+	std::map<int, void *>	persistent_pointers;
+
+	// sizes every subgraph for n bars, outside the study call
+
+	void resize(const int n) {
+
+		ArraySize	= n;
+		Index		= n - 1;
+
+		for (SCSubgraph & s : Subgraph) {
+
+			s.Data.v.assign(n, 0);
+
+			for (SCFloatArray & a : s.Arrays)
+
+				a.v.assign(n, 0);
+
+		}
+
+	}
+
+	// persistent storage
+
+	int & GetPersistentInt(const int key) { return persistent_ints[key]; }
+
+	float & GetPersistentFloat(const int key) { return persistent_floats[key]; }
+
+	double & GetPersistentDouble(const int key) { return persistent_doubles[key]; }
+
+	void * & GetPersistentPointer(const int key) { return persistent_pointers[key]; }
+
+	void SetPersistentPointer(const int key, void * p) { persistent_pointers[key] = p; }
+
+	// time and sales
+
+	void GetTimeAndSalesForSymbol(const SCString & symbol, c_SCTimeAndSalesArray & tas) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		tas.data = d != NULL ? d->tas.data() : NULL;
+		tas.size = d != NULL ? static_cast<int>(d->tas.size()) : 0;
+
+	}
+
+	void GetTimeAndSales(c_SCTimeAndSalesArray & tas) const { GetTimeAndSalesForSymbol(Symbol, tas); }
+
+	// market depth
+
+	static int depth_entry(const std::vector<s_MarketDepthEntry> * side, s_MarketDepthEntry & e, const int level) {
+
+		if (side == NULL || level < 0 || level >= static_cast<int>(side->size())) {
+
+			e = s_MarketDepthEntry();
+
+			return 0;
+
+		}
+
+		e = (*side)[level];
+
+		return 1;
+
+	}
+
+	int GetBidMarketDepthEntryAtLevelForSymbol(const SCString & symbol, s_MarketDepthEntry & e, const int level) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		return depth_entry(d != NULL ? &d->bids : NULL, e, level);
+
+	}
+
+	int GetAskMarketDepthEntryAtLevelForSymbol(const SCString & symbol, s_MarketDepthEntry & e, const int level) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		return depth_entry(d != NULL ? &d->asks : NULL, e, level);
+
+	}
+
+	int GetBidMarketDepthEntryAtLevel(s_MarketDepthEntry & e, const int level) const { return GetBidMarketDepthEntryAtLevelForSymbol(Symbol, e, level); }
+
+	int GetAskMarketDepthEntryAtLevel(s_MarketDepthEntry & e, const int level) const { return GetAskMarketDepthEntryAtLevelForSymbol(Symbol, e, level); }
+
+	int GetBidMarketDepthNumberOfLevelsForSymbol(const SCString & symbol) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		return d != NULL ? static_cast<int>(d->bids.size()) : 0;
+
+	}
+
+	int GetAskMarketDepthNumberOfLevelsForSymbol(const SCString & symbol) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		return d != NULL ? static_cast<int>(d->asks.size()) : 0;
+
+	}
+
+	int GetMaximumMarketDepthLevels() const { return sc_market.max_depth_levels; }
+
+	double GetSymbolDataValue(const SymbolDataValuesEnum value, const SCString & symbol, const bool = false, const bool = false) const {
+
+		const sc_symbol_data * d = sc_market.find(symbol.GetChars());
+
+		return value == SYMBOL_DATA_TICK_SIZE && d != NULL ? d->tick_size : 0;
+
+	}
+
+	// spreadsheets. the handle is the sc_sheet, stable for the process.
+
+	void * GetSpreadsheetSheetHandleByName(const char * file, const char * sheet, const bool) const {
+
+		static std::string key;
+
+		key.assign(file).append(1, '|').append(sheet);
+
+		auto it = sc_sheets.find(key);
+
+		if (it == sc_sheets.end())
+
+			it = sc_sheets.emplace(key, sc_sheet()).first;
+
+		return &it->second;
+
+	}
+
+	int GetSheetCellAsString(void * h, const int col, const int row, SCString & s) const {
+
+		const sc_sheet_cell * c = cell(h, col, row);
+
+		s = c != NULL && c->is_string ? c->s.c_str() : "";
+
+		return c != NULL;
+
+	}
+
+	int GetSheetCellAsDouble(void * h, const int col, const int row, double & d) const {
+
+		const sc_sheet_cell * c = cell(h, col, row);
+
+		if (c == NULL || c->is_string)
+
+			return 0;
+
+		d = c->d;
+
+		return 1;
+
+	}
+
+	int SetSheetCellAsString(void * h, const int col, const int row, const SCString & s) const {
+
+		if (h == NULL)
+
+			return 0;
+
+		sc_sheet_cell & c = static_cast<sc_sheet *>(h)->cells[{ col, row }];
+
+		c.is_string = true;
+		c.s.assign(s.GetChars());
+
+		return 1;
+
+	}
+
+	int SetSheetCellAsDouble(void * h, const int col, const int row, const double d) const {
+
+		if (h == NULL)
+
+			return 0;
+
+		sc_sheet_cell & c = static_cast<sc_sheet *>(h)->cells[{ col, row }];
+
+		c.is_string = false;
+		c.d			= d;
+
+		return 1;
+
+	}
+
+	static const sc_sheet_cell * cell(void * h, const int col, const int row) {
+
+		if (h == NULL)
+
+			return NULL;
+
+		const auto & cells	= static_cast<sc_sheet *>(h)->cells;
+		auto it				= cells.find({ col, row });
+
+		return it != cells.end() ? &it->second : NULL;
+
+	}
+
+	// study profiles, index 0 is the live one
+
+	int GetStudyProfileInformation(const int, const int index, n_ACSIL::s_StudyProfileInformation & p) const {
+
+		if (index < 0 || index >= static_cast<int>(sc_market.profiles.size()))
+
+			return 0;
+
+		p = sc_market.profiles[index];
+
+		return 1;
+
+	}
+
+	void AddMessageToLog(const char * message, const int) const {
+
+		sc_market.messages++;
+
+		if (sc_market.echo)
+
+			fprintf(stderr, "log: %s\n", message);
+
+	}
+
+};
+
+typedef s_sc & SCStudyInterfaceRef;
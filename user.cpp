@@ -2,1376 +2,4958 @@
 #include <cmath>
 #include <string>
 #include <stdlib.h>
+#include <cstdio>
+#include <chrono>
 #include <map>
+#include <vector>
 
 SCDLLName("user")
 
-SCSFExport scsf_order_flow(SCStudyInterfaceRef sc) {
 
-	#define MAX_SYMBOL_ROWS 1000
+// per-instance state behind a persistent pointer. allocated on the first
+// call, freed on the last call (returns NULL in that case).
 
-	#define input_head_col  0
-	#define input_val_col	1
-	#define stat_head_col   2
-	#define stat_val_col	3
+template <typename T>
+T * get_state(SCStudyInterfaceRef sc, const int key) {
 
-	#define symbol_row			0
-	#define trades_row			1
-	#define liq_lvls_row		2
-	#define min_rotation_row	3
-	#define num_rotations_row	4
+	T * state = reinterpret_cast<T *>(sc.GetPersistentPointer(key));
 
-	#define liquidity_balance_row	0
-	#define delta_row				1
-	#define imbalance_row			2
-	#define ask_tick_avg_row		3
-	#define bid_tick_avg_row		4
-	#define range_density_row		5
-	#define range_row				6
-	#define net_ticks_row			7
-	#define volume_row				8
-	#define sample_row				9
-	#define rotation_side_row		10
-	#define rotation_start_row		11
-	#define rotation_length_row		12
-	#define rotation_delta_row		13
-	#define rotation_volume_row     14
+	if (sc.LastCallToFunction) {
 
-	#define base_row_key			0
-	#define high_volume_key			1
-	#define rotation_side_key		2
-	#define rotation_high_key		3
-	#define rotation_low_key		4
-	#define rotation_length_key		5
-	#define up_rotation_delta_key 	6
-	#define dn_rotation_delta_key 	7
-	#define up_rotation_volume_key	8
-	#define dn_rotation_volume_key	9
-	#define ts_seq_key				10
+		if (state != NULL) {
 
-	// set defaults
-	
-	SCInputRef symbol_input	= sc.Input[0];
-	SCInputRef file_input	= sc.Input[1];
-	SCInputRef sheet_input	= sc.Input[2];
+			delete state;
 
-	int	&		base_row 			= sc.GetPersistentInt(base_row_key);
-	int &		high_volume			= sc.GetPersistentInt(high_volume_key);
-	int	&		rotation_side		= sc.GetPersistentInt(rotation_side_key);
-	double &	rotation_high		= sc.GetPersistentDouble(rotation_high_key);
-	double &	rotation_low		= sc.GetPersistentDouble(rotation_low_key);
-	double &	rotation_length		= sc.GetPersistentDouble(rotation_length_key);
-	int &		ts_seq				= sc.GetPersistentInt(ts_seq_key);
-	int	&		up_rotation_delta 	= sc.GetPersistentInt(up_rotation_delta_key);
-	int	&		dn_rotation_delta 	= sc.GetPersistentInt(up_rotation_delta_key);
-	int &		up_rotation_volume	= sc.GetPersistentInt(up_rotation_volume_key);
-	int &		dn_rotation_volume  = sc.GetPersistentInt(dn_rotation_volume_key);
+			sc.SetPersistentPointer(key, NULL);
 
-	if (sc.SetDefaults) {
+		}
 
-		sc.GraphName 			= "order_flow";
-		sc.AutoLoop 			= 0;
-		sc.UsesMarketDepthData 	= 1;
-		sc.HideStudy 			= 1;
+		return NULL;
 
-		symbol_input.Name = "symbol";
-		symbol_input.SetString("");
+	}
 
-		file_input.Name = "file_name";
-		file_input.SetString("");
+	if (state == NULL) {
 
-		sheet_input.Name = "sheet_name";
-		sheet_input.SetString("");
-		
-		base_row 			= -1;
-		high_volume			= -1;
-		rotation_side		= 0;
-		rotation_high		= DBL_MIN;
-		rotation_low		= DBL_MAX;
-		rotation_length 	= DBL_MIN;
-		up_rotation_delta   = 0;
-		dn_rotation_delta	= 0;
-		up_rotation_volume	= 0;
-		dn_rotation_volume  = 0;
-		ts_seq				= 0;
+		state = new T();
 
-		return;
+		sc.SetPersistentPointer(key, state);
 
 	}
 
-	// initialize base row by scanning spreadsheet for input symbol
+	return state;
 
-	const char * file_name	= file_input.GetString();
-	const char * sheet_name = sheet_input.GetString();
+}
 
-	if (
-		std::strcmp(file_name, "")	== 0 ||
-		std::strcmp(sheet_name, "")	== 0
-	)
 
-		// user has not initialized the spreadsheet inputs
+// work done during the current study call, sampled by study_timer. studies
+// run one at a time on the ui thread, so one set of counters is enough.
 
-		return;
+struct call_counters {
 
-	void * h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+	long long	records	= 0;	// trade records handed to readers
+	long long	levels	= 0;	// depth entries read from the api
 
-	if (base_row < 0) {
-		
-		const char * 	symbol = symbol_input.GetString(); 
-		SCString 		s;
+};
 
-		for (int i = 0; i < MAX_SYMBOL_ROWS; i++) {
+call_counters call_counts;
 
-			sc.GetSheetCellAsString(h, input_val_col, i, s);
 
-			if (!s.Compare(symbol)) {
+// log-linear latency histogram in nanoseconds: values below 16 are exact,
+// above that every power of two is split into 16 buckets, so a percentile
+// is within about 6% of the true value. fixed size, never allocates.
 
-				base_row = i;
-				break;
+#define LATENCY_SUB_BUCKETS	16
+#define LATENCY_OCTAVES		40	// covers up to 2^43 ns, about 2.4 hours
 
-			}
-		}
+struct latency_histogram {
 
-		if (base_row < 0)
+	unsigned int	counts[LATENCY_OCTAVES * LATENCY_SUB_BUCKETS];
+	long long		count	= 0;
+	long long		peak	= 0;	// largest value recorded
 
-			// user has not selected a symbol or spreadsheet is too large
+	latency_histogram() { clear(); }
 
-			return;
+	void clear() {
 
-	}
+		for (unsigned int & c : counts)
 
-	// initialize remaining inputs from spreadsheet
+			c = 0;
 
-	double d_trades			= -1.0;
-	double d_liq_lvls 		= -1.0;
-	double d_min_rotation	= -1.0;
-	double d_num_rotations  = -1.0;
+		count	= 0;
+		peak	= 0;
 
-	sc.GetSheetCellAsDouble(h, input_val_col, base_row + trades_row, d_trades);
-	sc.GetSheetCellAsDouble(h, input_val_col, base_row + liq_lvls_row, d_liq_lvls);
-	sc.GetSheetCellAsDouble(h, input_val_col, base_row + min_rotation_row, d_min_rotation);
-	sc.GetSheetCellAsDouble(h, input_val_col, base_row + num_rotations_row, d_num_rotations);
+	}
 
-	int trades			= static_cast<int>(d_trades);
-	int liq_levels  	= static_cast<int>(d_liq_lvls);
-	int min_rotation 	= static_cast<int>(d_min_rotation); 
-	int num_rotations   = static_cast<int>(d_num_rotations);
-	
-	c_SCTimeAndSalesArray tas;
+	static int bucket(long long v) {
 
-	if (trades > 0)
+		if (v < LATENCY_SUB_BUCKETS)
 
-		sc.GetTimeAndSales(tas);
+			return v > 0 ? static_cast<int>(v) : 0;
 
-	// compute stats
+		int e = 4;	// v is in [2^e, 2^(e + 1))
 
-	int len_tas	= tas.Size();
+		while ((v >> (e + 1)) != 0)
 
-	double first_price		= 0.0;
-	double last_price		= 0.0;
-	double prev_ask			= 0.0;
-	double prev_bid			= 0.0;
-	double ask_ticks		= 0.0;
-	double bid_ticks		= 0.0;
-	double at_bid_total		= 0.0;
-	double at_ask_total		= 0.0;
-	double imbalance		= 0.0;
-	double net_ticks		= 0.0;
-	double ask_tick_avg		= 0.0;
-	double bid_tick_avg		= 0.0;
-	double high_tick		= DBL_MIN;
-	double low_tick			= DBL_MAX;
-	double range			= 0.0;
-	double range_density	= 0.0;
-	double sample			= 0.0;
+			e++;
 
-	double delta 	= -1.0;
-	double volume	= 0.0;
+		const int b = (e - 3) * LATENCY_SUB_BUCKETS + static_cast<int>((v >> (e - 4)) - LATENCY_SUB_BUCKETS);
 
-	bool init_ts 			= false;
-	bool rotation_change 	= false;
+		return b < LATENCY_OCTAVES * LATENCY_SUB_BUCKETS ? b : LATENCY_OCTAVES * LATENCY_SUB_BUCKETS - 1;
 
-	if (len_tas > 0) {
+	}
 
-		int trade_count = 0;
-		// int start = max(len_tas - trades, 0);
+	// largest value that falls in bucket b
 
-		for (int i = 0; i < len_tas; i++) {
+	static long long bucket_max(const int b) {
 
-			// init
+		if (b < LATENCY_SUB_BUCKETS)
 
-			s_TimeAndSales r = tas[i];
-			r *= sc.RealTimePriceMultiplier;
+			return b;
 
-			if (!init_ts && r.Type != SC_TS_BIDASKVALUES) {
+		const int shift	= b / LATENCY_SUB_BUCKETS - 1;
+		const int sub	= b % LATENCY_SUB_BUCKETS;
 
-				// first trade record, initialize everything
+		return (static_cast<long long>(LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
 
-				first_price = r.Price;
-				prev_bid 	= r.Price;
-				prev_ask	= r.Price;
+	}
 
-				init_ts = true;
+	void record(const long long ns) {
 
-			}
+		counts[bucket(ns)]++;
+		count++;
 
-			// range, absorbtion, density, etc.
+		if (ns > peak)
 
-			switch(r.Type) {
+			peak = ns;
 
-				case SC_TS_BID:
+	}
 
-					at_bid_total	+=	r.Volume;
-					last_price		=	r.Price;
-					trade_count		+=	1;
-					low_tick		=	min(r.Price, low_tick);
+	// q in [0, 1]
 
-					if (r.Price < prev_bid)
+	long long percentile(const double q) const {
 
-						bid_ticks += ((prev_bid - r.Price) / sc.TickSize);
+		if (count == 0)
 
-					prev_bid = r.Price;					
+			return 0;
 
-					// sc.AddMessageToLog(("at_bid: " + std::to_string(at_bid)).c_str(), 1);
+		const long long	target	= static_cast<long long>(std::ceil(q * count));
+		long long		seen	= 0;
 
-					break;
+		for (int b = 0; b < LATENCY_OCTAVES * LATENCY_SUB_BUCKETS; b++) {
 
-				case SC_TS_ASK:
+			seen += counts[b];
 
-					at_ask_total	+= 	r.Volume;
-					last_price		=	r.Price;
-					trade_count		+=	1;
-					high_tick		=	max(r.Price, high_tick);
+			if (seen >= target && seen > 0)
 
-					if (r.Price > prev_ask)
+				return bucket_max(b) < peak ? bucket_max(b) : peak;
 
-						ask_ticks += ((r.Price - prev_ask) / sc.TickSize);
+		}
 
-					prev_ask = r.Price;
+		return peak;
 
-					// sc.AddMessageToLog(("at_ask" + std::to_string(at_ask)).c_str(), 1);
-					
-					break;
+	}
 
-				case SC_TS_BIDASKVALUES:
+};
 
-					break;
 
-				default:
+// per-call instrumentation, constructed first thing in every exported study.
+// when the latency_stats input is on, each call's wall time and the records
+// and depth levels it read are accumulated per study instance. p50, p99 and
+// max (microseconds) go to three hidden subgraphs, and a summary is logged
+// every latency_log_seconds; each summary starts a new window. the
+// percentiles scan the histogram, so the subgraphs show values refreshed
+// every LATENCY_REFRESH calls and at each summary.
 
-					break;
-				
-			}
+#define LATENCY_STATE_KEY		99	// persistent pointer, clear of the studies' own keys
+#define LATENCY_ENABLE_INPUT	126
+#define LATENCY_LOG_INPUT		127
+#define LATENCY_SUBGRAPH		57	// p50, p99, max
+#define LATENCY_REFRESH			64	// calls between percentile scans
 
-			// rotations
+struct latency_state {
 
-			if (r.Type != SC_TS_BIDASKVALUES && r.Sequence > ts_seq) {
+	latency_histogram						h;
+	long long								records	= 0;
+	long long								levels	= 0;
+	float									p50		= 0;	// microseconds, as of the last scan
+	float									p99		= 0;
+	std::chrono::steady_clock::time_point	logged	= std::chrono::steady_clock::now();
 
-				ts_seq			= r.Sequence;
+};
 
-				if (r.Price > rotation_high) {
+struct study_timer {
 
-					rotation_high 		= r.Price;
-					dn_rotation_delta 	= 0;
-					dn_rotation_volume	= 0;
+	SCStudyInterfaceRef						sc;
+	const char *							name;
+	latency_state *							state	= NULL;
+	call_counters							start_counts;
+	std::chrono::steady_clock::time_point	start;
 
-				}
+	study_timer(SCStudyInterfaceRef sc, const char * name) : sc(sc), name(name) {
 
-				if (r.Price < rotation_low) {
+		if (sc.SetDefaults) {
 
-					rotation_low 		= r.Price;
-					up_rotation_delta	= 0;
-					up_rotation_volume	= 0;
+			sc.Input[LATENCY_ENABLE_INPUT].Name = "latency_stats";
+			sc.Input[LATENCY_ENABLE_INPUT].SetYesNo(0);
 
-				}
+			sc.Input[LATENCY_LOG_INPUT].Name = "latency_log_seconds";
+			sc.Input[LATENCY_LOG_INPUT].SetInt(60);
 
-				int signed_volume = r.Type == SC_TS_BID ? -r.Volume : r.Volume;
+			sc.Subgraph[LATENCY_SUBGRAPH].Name 			= "latency_p50_us";
+			sc.Subgraph[LATENCY_SUBGRAPH + 1].Name 		= "latency_p99_us";
+			sc.Subgraph[LATENCY_SUBGRAPH + 2].Name 		= "latency_max_us";
+			sc.Subgraph[LATENCY_SUBGRAPH].DrawStyle		= DRAWSTYLE_IGNORE;
+			sc.Subgraph[LATENCY_SUBGRAPH + 1].DrawStyle	= DRAWSTYLE_IGNORE;
+			sc.Subgraph[LATENCY_SUBGRAPH + 2].DrawStyle	= DRAWSTYLE_IGNORE;
 
-				up_rotation_delta 	+= signed_volume;
-				up_rotation_volume 	+= r.Volume;
-				dn_rotation_delta 	+= signed_volume;
-				dn_rotation_volume  += r.Volume;
-				
-				// rotation_high 	= max(rotation_high, r.Price);
-				// rotation_low	= min(rotation_low, r.Price);
+			return;
 
-				double from_rotation_high 	= (rotation_high - r.Price) / sc.TickSize;
-				double from_rotation_low	= (r.Price - rotation_low) / sc.TickSize;
+		}
 
-				if (from_rotation_high >= min_rotation) {
+		if (!sc.LastCallToFunction && !sc.Input[LATENCY_ENABLE_INPUT].GetYesNo())
 
-					// in down rotation
-					
-					if (rotation_side > -1) {
+			return;
 
-						// from up rotation
+		// on the last call this frees the state and returns NULL
 
-						rotation_change		= true;
-						rotation_side 		= -1;
-						rotation_low 		= r.Price;
-						rotation_length		= from_rotation_high;
-						// up_rotation_delta 	= 0;
+		state = get_state<latency_state>(sc, LATENCY_STATE_KEY);
 
-						continue;			// skip subsequent if block
+		if (state == NULL)
 
-					} else
-					
-						// continuing down rotation
+			return;
 
-						rotation_length = max(from_rotation_high, rotation_length);
-				
-				}
+		start_counts	= call_counts;
+		start			= std::chrono::steady_clock::now();
 
-				if (from_rotation_low >= min_rotation) {
+	}
 
-					// in up rotation
+	~study_timer() {
 
-					if (rotation_side < 1) {
+		if (state == NULL)
 
-						// from down rotation
+			return;
 
-						rotation_change		= true;
-						rotation_side		= 1;
-						rotation_high		= r.Price;
-						rotation_length 	= from_rotation_low;
-						// dn_rotation_delta 	= 0;
- 
-					} else
+		const auto		now	= std::chrono::steady_clock::now();
+		const long long	ns	= std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
 
-						// continuing up rotation
+		state->h.record(ns);
+		state->records	+= call_counts.records - start_counts.records;
+		state->levels	+= call_counts.levels - start_counts.levels;
 
-						rotation_length = max(from_rotation_low, rotation_length);
+		const int	interval	= sc.Input[LATENCY_LOG_INPUT].GetInt();
+		const bool	log			= interval > 0 && now - state->logged >= std::chrono::seconds(interval);
 
-				}
+		if (log || state->h.count % LATENCY_REFRESH == 1) {
 
-			}
+			state->p50 = state->h.percentile(0.50) / 1000.0f;
+			state->p99 = state->h.percentile(0.99) / 1000.0f;
 
 		}
 
-		// compute normalized delta
-
-		if (at_bid_total > 0.0)
-		
-			delta = at_ask_total / at_bid_total;
-
-		volume = at_bid_total + at_ask_total;
+		const float p50		= state->p50;
+		const float p99		= state->p99;
+		const float peak	= state->h.peak / 1000.0f;
 
-		// compute normalized volume
+		sc.Subgraph[LATENCY_SUBGRAPH][sc.Index] 	= p50;
+		sc.Subgraph[LATENCY_SUBGRAPH + 1][sc.Index] = p99;
+		sc.Subgraph[LATENCY_SUBGRAPH + 2][sc.Index] = peak;
 
-		if (volume > high_volume)
+		if (!log)
 
-			high_volume = volume;
+			return;
 
-		volume /= high_volume;
+		char msg[256];
 
-		// compute total ticks, net imbalance		
+		snprintf(
+			msg,
+			sizeof(msg),
+			"latency %s %s calls: %lld p50: %.1fus p99: %.1fus max: %.1fus records: %lld levels: %lld",
+			name,
+			sc.Symbol.GetChars(),
+			state->h.count,
+			p50,
+			p99,
+			peak,
+			state->records,
+			state->levels
+		);
 
-		net_ticks	= (last_price - first_price) / sc.TickSize;
-		imbalance	= at_ask_total - at_bid_total;
+		sc.AddMessageToLog(msg, 0);
 
-		// compute average ticks
+		state->h.clear();
 
-		if (ask_ticks > 0)
+		state->records	= 0;
+		state->levels	= 0;
+		state->logged	= now;
 
-			ask_tick_avg = at_ask_total / ask_ticks;
+	}
 
-		if (bid_ticks > 0)
+};
 
-			bid_tick_avg = at_bid_total / bid_ticks;
 
-		// compute sample (lots in num_trades)
+// process-wide cache of trade records, one per symbol, shared by every study
+// instance in the dll. the first reader to update during a chart update pulls
+// the symbol's time and sales and appends records past the last sequence
+// number; other readers in the same update read the appended records in
+// place. sierra chart calls study functions from a single thread, so the
+// cache is not locked. pointers into the cache are only valid until the
+// next update.
+//
+// the cache holds at most TICK_CACHE_MAX records. storage doubles from
+// TICK_CACHE_MIN as records arrive, so a quiet symbol stays small, and stops
+// at the cap. when it is full the older half is dropped in place, so a long
+// session never reallocates; readers keep absolute cursors and a reader that
+// falls behind the dropped records restarts from what is left.
 
-		sample = at_bid_total + at_ask_total;
+#define TICK_CACHE_MIN (1 << 12)
+#define TICK_CACHE_MAX (1 << 20)	// records per symbol, 16 mb
 
-		if (high_tick - low_tick > 0) {
+struct tick {
 
-			range			= (high_tick - low_tick) / sc.TickSize;
-			range_density 	= (at_ask_total + at_bid_total) / range;
+	float			price;
+	int				volume;
+	unsigned int	seq;
+	char			type;		// SC_TS_BID or SC_TS_ASK
 
-		}
+};
 
-	}
 
-	// compute liquidity balance
+struct tick_cache {
 
-	int 	total_bids 			= 0;
-	int 	total_asks 			= 0;
-	float	liquidity_balance 	= -1.0;
+	std::string				symbol;
+	SCString				sc_symbol;			// passed to the api without a per call conversion
+	int						refs		= 0;
+	int						generation	= 0;	// bumped when sequence numbers restart
+	unsigned int			seq			= 0;	// last sequence number appended
+	size_t					dropped		= 0;	// records trimmed from the front
+	SCDateTimeMS			pulled;				// time of the last pull
 
-	s_MarketDepthEntry e;
+	std::vector<tick>		ticks;
+	c_SCTimeAndSalesArray	tas;				// reused pull buffer
 
-	for (int i = 0; i < liq_levels; i++) {
+};
 
-		sc.GetBidMarketDepthEntryAtLevel(e, i);
-		total_bids += e.Quantity;
 
-		sc.GetAskMarketDepthEntryAtLevel(e, i);
-		total_asks += e.Quantity;
+std::map<std::string, tick_cache *> tick_caches;
 
-	}
 
-	liquidity_balance = static_cast<float>(total_asks) / total_bids;
+tick_cache * tick_cache_acquire(const char * symbol) {
 
-	// clear spreadsheet
+	tick_cache * & cache = tick_caches[symbol];
 
-	const int 	lo = base_row + 1;
-	int			hi = base_row + sample_row;
-	SCString 	clr = "";
-	SCString 	fmt;
+	if (cache == NULL) {
 
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + liquidity_balance_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + delta_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + imbalance_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + ask_tick_avg_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + bid_tick_avg_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + range_density_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + range_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + net_ticks_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + volume_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + sample_row, clr);
+		cache 				= new tick_cache();
+		cache->symbol		= symbol;
+		cache->sc_symbol	= symbol;
 
-	// fill spreadsheet
+	}
 
-	if (rotation_change) {
+	cache->refs++;
 
-		// shift old rotations right on change
+	return cache;
 
-		SCString 	d_old_rotation_side;
-		double 		d_old_rotation_start;
-		double      d_old_rotation_length;
-		double      d_old_rotation_delta;
-		double 		d_old_rotation_volume;
+}
 
-		for (int i = num_rotations - 1; i > 0; i--) {
 
-			sc.GetSheetCellAsString(h, stat_val_col + i - 1, base_row + rotation_side_row, d_old_rotation_side);
-			sc.GetSheetCellAsDouble(h, stat_val_col + i - 1, base_row + rotation_start_row, d_old_rotation_start);
-			sc.GetSheetCellAsDouble(h, stat_val_col + i - 1, base_row + rotation_length_row, d_old_rotation_length);
-			sc.GetSheetCellAsDouble(h, stat_val_col + i - 1, base_row + rotation_delta_row, d_old_rotation_delta);
-			sc.GetSheetCellAsDouble(h, stat_val_col + i - 1, base_row + rotation_volume_row, d_old_rotation_volume);
+void tick_cache_release(tick_cache * cache) {
 
-			sc.SetSheetCellAsString(h, stat_val_col + i, base_row + rotation_side_row, d_old_rotation_side);
-			sc.SetSheetCellAsDouble(h, stat_val_col + i, base_row + rotation_start_row, d_old_rotation_start);
-			sc.SetSheetCellAsDouble(h, stat_val_col + i, base_row + rotation_length_row, d_old_rotation_length);
-			sc.SetSheetCellAsDouble(h, stat_val_col + i, base_row + rotation_delta_row, d_old_rotation_delta);
-			sc.SetSheetCellAsDouble(h, stat_val_col + i, base_row + rotation_volume_row, d_old_rotation_volume);
+	if (--cache->refs > 0)
 
-		}
+		return;
 
-	}
+	tick_caches.erase(cache->symbol);
 
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + liquidity_balance_row, fmt.Format("%.2f", liquidity_balance));
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + delta_row, fmt.Format("%.2f", delta));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + imbalance_row, imbalance);
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + ask_tick_avg_row, static_cast<int>(ask_tick_avg));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + bid_tick_avg_row, static_cast<int>(bid_tick_avg));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + range_density_row, static_cast<int>(range_density));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + range_row, static_cast<int>(range));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + net_ticks_row, static_cast<int>(net_ticks));
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + volume_row, fmt.Format("%.2f", volume));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + sample_row, sample);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + rotation_side_row, rotation_side == 1 ? "up" : rotation_side == -1 ? "dn" : "");
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + rotation_start_row, rotation_side == 1 ? rotation_low : rotation_side == -1 ? rotation_high : -1);
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + rotation_length_row, static_cast<int>(rotation_length));
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + rotation_delta_row, rotation_side == 1 ? up_rotation_delta : dn_rotation_delta);
-	sc.SetSheetCellAsDouble(h, stat_val_col, base_row + rotation_volume_row, rotation_side == 1 ? up_rotation_volume : dn_rotation_volume);
+	delete cache;
 
 }
 
 
-// displays the current rotation start, as well as the endpoint average and max rotations from that point.
-// the rotation input is defined in ticks.
-// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
-// under the study settings, make sure to:
-//		
-//		- set "Chart Region" to 1
-// 		- uncheck "Draw Study Underneath Main Price Graph"
-//		- set the tick size correctly in "Value Format"
-//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
-//		- check "Value Label"
-//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+void tick_cache_update(SCStudyInterfaceRef sc, tick_cache * cache) {
 
+	if (cache->pulled == sc.CurrentSystemDateTimeMS && !cache->ticks.empty())
 
-SCSFExport scsf_rotation(SCStudyInterfaceRef sc) {
+		// already pulled during this update
 
-	SCInputRef min_rotation_input = sc.Input[0];
+		return;
 
-	int &		ts_seq				= sc.GetPersistentInt(0);
-	int	&		rotation_side		= sc.GetPersistentInt(1);
-	double &	rotation_high		= sc.GetPersistentDouble(2);
-	double &	rotation_low		= sc.GetPersistentDouble(3);
-	double &	rotation_length		= sc.GetPersistentDouble(4);
-	int & 		rotation_count 		= sc.GetPersistentInt(5);
-	double &	rotation_len_sum	= sc.GetPersistentDouble(6);
-	double &	rotation_len_max	= sc.GetPersistentDouble(7);
+	cache->pulled = sc.CurrentSystemDateTimeMS;
 
-	if (sc.SetDefaults) {
+	sc.GetTimeAndSalesForSymbol(cache->sc_symbol, cache->tas);
 
-		sc.GraphName 			= "rotation";
-		sc.AutoLoop 			= 0;
-		sc.UsesMarketDepthData 	= 1;
+	const c_SCTimeAndSalesArray &	tas 	= cache->tas;
+	const int 						len_tas	= tas.Size();
 
-		sc.Subgraph[0].Name = "start";
-		sc.Subgraph[1].Name = "end";
-		sc.Subgraph[2].Name = "avg";
-		sc.Subgraph[3].Name = "max";
+	if (len_tas == 0)
 
-		ts_seq				= 0;
-		rotation_side		= 0;
-		rotation_high		= DBL_MIN;
-		rotation_low		= DBL_MAX;
-		rotation_length 	= DBL_MIN;
-		rotation_count		= 0;
-		rotation_len_sum    = 0.0;
-		rotation_len_max    = 0.0;
+		return;
 
-		min_rotation_input.Name = "min_rotation";
-		min_rotation_input.SetInt(0);
+	if (tas[len_tas - 1].Sequence < cache->seq) {
 
-		return;
+		// sequence numbers restarted (new session or reload)
 
-	}
+		cache->ticks.clear();
+		cache->seq		= 0;
+		cache->dropped	= 0;
+		cache->generation++;
 
-	const float	min_rotation = min_rotation_input.GetInt() * sc.TickSize;
+	}
 
-	if (min_rotation <= 0)
+	int start = len_tas;
 
-		return;
+	while (start > 0 && tas[start - 1].Sequence > cache->seq)
 
-	c_SCTimeAndSalesArray tas;
-	sc.GetTimeAndSales(tas);
+		start--;
 
-	int len_tas	= tas.Size();
+	if (len_tas - start > TICK_CACHE_MAX)
 
-	for (int i = 0; i < len_tas; i++) {
+		// cold start on a long session, older records would be dropped anyway
 
-		s_TimeAndSales r = tas[i];
+		start = len_tas - TICK_CACHE_MAX;
 
-		if (r.Type != SC_TS_BIDASKVALUES && r.Sequence > ts_seq) {
+	std::vector<tick> & ticks = cache->ticks;
 
-			r 		*= sc.RealTimePriceMultiplier;
-			ts_seq	=  r.Sequence;
+	for (int i = start; i < len_tas; i++) {
 
-			if (r.Price > rotation_high)
+		const s_TimeAndSales & r = tas[i];
 
-				rotation_high = r.Price;
+		if (r.Type != SC_TS_BID && r.Type != SC_TS_ASK)
 
-			if (r.Price < rotation_low)
+			continue;
 
-				rotation_low = r.Price;
-			
-			double from_rotation_high 	= rotation_high - r.Price;
-			double from_rotation_low	= r.Price - rotation_low;
+		if (ticks.size() == TICK_CACHE_MAX) {
 
-			if (from_rotation_high >= min_rotation) {
+			// full, keep the newer half without reallocating
 
-				// in down rotation
-				
-				if (rotation_side > -1) {
+			ticks.erase(ticks.begin(), ticks.begin() + TICK_CACHE_MAX / 2);
 
-					// from up rotation
-					
-					rotation_count      += 1;
-					rotation_len_sum    += rotation_length;
-					rotation_side 		=  -1;
-					rotation_low 		=  r.Price;
-					rotation_length		=  from_rotation_high;
-					rotation_len_max 	= max(rotation_length, rotation_len_max);
+			cache->dropped += TICK_CACHE_MAX / 2;
 
-					continue;			// skip subsequent if block
+		} else if (ticks.size() == ticks.capacity()) {
 
-				} else
-				
-					// continuing down rotation
+			// grow by doubling, never past the cap
 
-					rotation_length		= max(from_rotation_high, rotation_length);
-			
-			}
+			const size_t c = ticks.capacity() * 2;
 
-			if (from_rotation_low >= min_rotation) {
+			ticks.reserve(c < TICK_CACHE_MIN ? TICK_CACHE_MIN : c > TICK_CACHE_MAX ? TICK_CACHE_MAX : c);
 
-				// in up rotation
+		}
 
-				if (rotation_side < 1) {
+		ticks.push_back({ r.Price, static_cast<int>(r.Volume), r.Sequence, static_cast<char>(r.Type) });
 
-					// from down rotation
-						
-					rotation_count      += 1;
-					rotation_len_sum    += rotation_length;
-					rotation_side		=  1;
-					rotation_high		=  r.Price;
-					rotation_length 	=  from_rotation_low;
+	}
 
-				} else
+	cache->seq = tas[len_tas - 1].Sequence;
 
-					// continuing up rotation
+}
 
-					rotation_length 	= max(from_rotation_low, rotation_length);
 
-			}
+// a study's cursor into a tick_cache. released with the owning state.
 
-			rotation_len_max = max(rotation_length, rotation_len_max);
+struct tick_reader {
 
-		}
+	tick_cache *	cache		= NULL;
+	size_t			cursor		= 0;	// absolute, counts the cache's dropped records
+	int				generation	= 0;
+	bool			restarted	= false;	// set by read() when the cache was reset
 
-	}
+	~tick_reader() { close(); }
 
-	const float rotation_len_avg = rotation_len_sum / rotation_count;
+	void open(const char * symbol) {
 
-	const float start 	= rotation_side == 1 ? rotation_low : rotation_side == -1 ? rotation_high : 0;
-	const float end     = rotation_side == 1 ? rotation_high : rotation_side == -1 ? rotation_low : 0;
-	const float avg 	= rotation_side == 1 ? start + rotation_len_avg : rotation_side == -1 ? start - rotation_len_avg : 0;
-	const float max 	= rotation_side == 1 ? start + rotation_len_max : rotation_side == -1 ? start - rotation_len_max : 0;
+		if (cache != NULL && cache->symbol.compare(symbol) == 0)
 
-	// sc.AddMessageToLog(("rotation_len_max: " + std::to_string(rotation_len_max)).c_str(), 1);
+			return;
 
-	sc.Subgraph[0][sc.Index] = start;
-	sc.Subgraph[1][sc.Index] = end;
-	sc.Subgraph[2][sc.Index] = avg;
-	sc.Subgraph[3][sc.Index] = max;
+		close();
 
-}
+		cache 		= tick_cache_acquire(symbol);
+		cursor		= 0;
+		generation	= cache->generation;
 
+	}
 
-double vwap(
-	const SCStudyInterfaceRef &	sc,
-	const SCString & 			sym, 
-	const int & 				num_trades
-) {
+	void close() {
 
-	c_SCTimeAndSalesArray tas;
+		if (cache != NULL)
 
-	sc.GetTimeAndSalesForSymbol(sym, tas);
+			tick_cache_release(cache);
 
-	const int 		len_tas			= tas.Size();
-	int				total_volume 	= 0; 
-	double 			vwap_			= 0;
-	int 			trade_count		= 0;
-	s_TimeAndSales	r;
+		cache = NULL;
 
-	// sc.AddMessageToLog(("len_tas: " + std::to_string(len_tas)).c_str(), 1);
+	}
 
-	for (int i = len_tas - 1; i >= 0 && trade_count < num_trades; i--) {
+	// updates the cache and returns the records appended since the last
+	// read, or all of them after a restart. records dropped before this
+	// reader saw them also count as a restart.
 
-		r = tas[i];
-		r *= sc.RealTimePriceMultiplier;
+	const tick * read(SCStudyInterfaceRef sc, int & n) {
 
-		if (r.Type != SC_TS_BIDASKVALUES) {
+		tick_cache_update(sc, cache);
 
-			total_volume	+= r.Volume;
-			trade_count 	+= 1;
-		
-		}
-	
-	}
+		const size_t end = cache->dropped + cache->ticks.size();
 
-	trade_count = 0;
+		restarted = generation != cache->generation || cursor > end || cursor < cache->dropped;
 
-	// sc.AddMessageToLog(("total_volume: " + std::to_string(total_volume)).c_str(), 1);
+		if (restarted) {
 
-	for (int i = len_tas - 1; i >= 0 && trade_count < num_trades; i--) {
-		
-		r = tas[i];
-		r *= sc.RealTimePriceMultiplier;
+			generation	= cache->generation;
+			cursor		= cache->dropped;
 
-		if (r.Type != SC_TS_BIDASKVALUES) {
+		}
 
-			// sc.AddMessageToLog(("r.Price: " + std::to_string(r.Price)).c_str(), 1);
-			// sc.AddMessageToLog(("r.Volume: " + std::to_string(r.Volume)).c_str(), 1);
+		n 		= static_cast<int>(end - cursor);
+		cursor 	= end;
 
-			vwap_ 		+= (r.Price * r.Volume / total_volume);
-			trade_count += 1;
+		call_counts.records += n;
 
-		}
+		return cache->ticks.data() + cache->ticks.size() - n;
 
 	}
 
-	// sc.AddMessageToLog(("vwap (vwap_func): " + std::to_string(vwap_)).c_str(), 1);
+};
+
+
+// converts a price to a whole number of ticks
+
+inline int to_ticks(const float price, const float tick_size) {
 
-	return vwap_;
+	return static_cast<int>(std::lround(price / tick_size));
 
 }
 
 
-// computes vwap of a two-leg spread using the outright contracts
-// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
-// under the study settings, make sure to:
-//		
-//		- set "Chart Region" to 1
-// 		- uncheck "Draw Study Underneath Main Price Graph"
-//		- set the tick size correctly in "Value Format"
-//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
-//		- check "Value Label"
-//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+// a symbol's tick size and real time price multiplier. trade and depth
+// prices are converted to integer ticks once, when they enter a study's
+// state; arithmetic and comparisons after that are exact. price() converts
+// back for output.
 
+struct tick_scale {
 
-SCSFExport scsf_two_leg_spread_vwap(SCStudyInterfaceRef sc) {
+	float tick_size		= 1;
+	float multiplier	= 1;
 
-	SCInputRef front_leg_sym 	= sc.Input[0];
-	SCInputRef front_leg_qty 	= sc.Input[1];
-	SCInputRef back_leg_sym 	= sc.Input[2];
-	SCInputRef back_leg_qty 	= sc.Input[3];
-	SCInputRef num_trades		= sc.Input[4];
+	tick_scale() {}
 
-	if (sc.SetDefaults) {
+	tick_scale(const float tick_size_, const float multiplier_) : tick_size(tick_size_), multiplier(multiplier_) {}
 
-		sc.GraphName 		= "two_leg_spread_vwap";
-		sc.AutoLoop 		= 0;
+	// the chart's symbol
 
-		sc.Subgraph[0].Name = "vwap";
+	explicit tick_scale(SCStudyInterfaceRef sc) : tick_size(sc.TickSize), multiplier(sc.RealTimePriceMultiplier) {}
 
-		front_leg_sym.Name = "front_leg_sym";
-		front_leg_sym.SetString("");
+	// a raw (unadjusted) trade price
 
-		front_leg_qty.Name = "front_leg_qty";
-		front_leg_qty.SetInt(0);
+	int ticks(const float raw) const { return to_ticks(raw * multiplier, tick_size); }
 
-		back_leg_sym.Name = "back_leg_sym";
-		back_leg_sym.SetString("");
+	// an already adjusted price, e.g. depth AdjustedPrice or DailyHigh
 
-		back_leg_qty.Name = "back_leg_qty";
-		back_leg_qty.SetInt(0);
+	int adjusted_ticks(const float adjusted) const { return to_ticks(adjusted, tick_size); }
 
-		num_trades.Name = "num_trades";
-		num_trades.SetInt(0);
+	float price(const int t) const { return t * tick_size; }
 
-		return;
+};
 
-	}
 
-	const char * 	front_leg_sym_val 	= front_leg_sym.GetString();
-	const char * 	back_leg_sym_val	= back_leg_sym.GetString();
-	int 			front_leg_qty_val	= front_leg_qty.GetInt();
-	int				back_leg_qty_val 	= back_leg_qty.GetInt();
-	int 			num_trades_val 		= num_trades.GetInt();
+// batch kernels over struct-of-arrays int data, used by tas_window::fill().
+// avx2 when the dll is built with it (/arch:AVX2), scalar otherwise.
 
-	if (
-		std::strcmp(front_leg_sym_val, "")	== 0 ||
-		std::strcmp(back_leg_sym_val, "")	== 0 ||
-		front_leg_qty_val 					== 0 ||
-		back_leg_qty_val					== 0 ||
-		num_trades_val 						== 0
-	)
+#if defined(__AVX2__)
 
-		// study not initialized
+#include <immintrin.h>
 
-		return;
+// horizontal sum of four int64 lanes
 
-	const double front_leg_vwap = vwap(sc, front_leg_sym_val, num_trades_val);
-	const double back_leg_vwap	= vwap(sc, back_leg_sym_val, num_trades_val);
-	const double vwap_ 			= front_leg_vwap * front_leg_qty_val + back_leg_vwap * back_leg_qty_val;
+inline long long hsum_epi64(const __m256i v) {
 
-	// sc.AddMessageToLog(("front_leg_vwap: " + std::to_string(front_leg_vwap)).c_str(), 1);
-	// sc.AddMessageToLog(("back_leg_vwap: " + std::to_string(back_leg_vwap)).c_str(), 1);
-	// sc.AddMessageToLog(("vwap_: " + std::to_string(vwap_)).c_str(), 1);
+	const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
 
-	sc.Subgraph[0][sc.Index] = vwap_;
+	return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
 
 }
 
+#endif
 
-// computes vwap of a single symbol
-// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
-// under the study settings, make sure to:
-//		
-//		- set "Chart Region" to 1
-// 		- uncheck "Draw Study Underneath Main Price Graph"
-//		- set the tick size correctly in "Value Format"
-//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
-//		- check "Value Label"
-//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+
+// sum of v[0 .. n)
+
+inline long long batch_sum(const int * v, const int n) {
+
+	long long	s = 0;
+	int			i = 0;
+
+#if defined(__AVX2__)
+
+	__m256i acc = _mm256_setzero_si256();
+
+	for (; i + 8 <= n; i += 8) {
+
+		const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i));
+
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+
+	}
+
+	s = hsum_epi64(acc);
+
+#endif
+
+	for (; i < n; i++)
+
+		s += v[i];
+
+	return s;
+
+}
+
+
+// monotone tick increments of one side's prints: out[i] is how far p[i]
+// moved past p[i - 1] in the direction dir (+1 up, -1 down), or 0, with
+// p[-1] = prev. returns the sum.
+
+inline long long batch_increments(const int * p, const int n, const int prev, const int dir, int * out) {
+
+	if (n == 0)
+
+		return 0;
+
+	const int	d0	= (p[0] - prev) * dir;
+	long long	s	= out[0] = d0 > 0 ? d0 : 0;
+	int			i	= 1;
+
+#if defined(__AVX2__)
+
+	const __m256i	sign	= _mm256_set1_epi32(dir);
+	const __m256i	zero	= _mm256_setzero_si256();
+	__m256i			acc		= _mm256_setzero_si256();
+
+	for (; i + 8 <= n; i += 8) {
+
+		const __m256i cur	= _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		const __m256i prv	= _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i - 1));
+		const __m256i d		= _mm256_max_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(cur, prv), sign), zero);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), d);
+
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(d)));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(d, 1)));
+
+	}
+
+	s += hsum_epi64(acc);
+
+#endif
+
+	for (; i < n; i++) {
+
+		const int d = (p[i] - p[i - 1]) * dir;
+
+		out[i]	= d > 0 ? d : 0;
+		s		+= out[i];
+
+	}
+
+	return s;
+
+}
+
+
+// sliding window over the last n trade records. every accumulator is updated
+// by adding the incoming record and subtracting the evicted one, so a call
+// costs O(new records) rather than O(session). high and low are kept with
+// monotonic queues over the ask and bid prints respectively. fill() loads an
+// empty window in one batch, for cold starts over a long session.
+
+struct tas_window {
+
+	int 				capacity		= 0;
+	int 				count			= 0;
+	long long			pushed			= 0;	// absolute index of the next record
+
+	std::vector<int>	price;					// ticks
+	std::vector<int>	volume;
+	std::vector<char>	type;
+	std::vector<int>	ticks;					// tick increment contributed on entry
+
+	std::vector<long long>	hi_q;				// ask prints, descending price
+	std::vector<long long>	lo_q;				// bid prints, ascending price
+	long long			hi_head			= 0;
+	long long			hi_tail			= 0;
+	long long			lo_head			= 0;
+	long long			lo_tail			= 0;
+
+	std::vector<int>	side_p[2];				// fill() scratch: prices, volumes, positions
+	std::vector<int>	side_v[2];				// and increments by side (0 bid, 1 ask)
+	std::vector<int>	side_i[2];
+	std::vector<int>	side_t[2];
+
+	long long			at_bid_total	= 0;
+	long long			at_ask_total	= 0;
+	long long			bid_ticks		= 0;
+	long long			ask_ticks		= 0;
+	int					prev_bid		= 0;
+	int					prev_ask		= 0;
+
+	void reset(const int n) {
+
+		capacity		= n;
+		count			= 0;
+		pushed			= 0;
+		hi_head			= 0;
+		hi_tail			= 0;
+		lo_head			= 0;
+		lo_tail			= 0;
+		at_bid_total	= 0;
+		at_ask_total	= 0;
+		bid_ticks		= 0;
+		ask_ticks		= 0;
+		prev_bid		= 0;
+		prev_ask		= 0;
+
+		price.assign(n, 0);
+		volume.assign(n, 0);
+		type.assign(n, 0);
+		ticks.assign(n, 0);
+		hi_q.assign(n, 0);
+		lo_q.assign(n, 0);
+
+	}
+
+	void evict() {
+
+		const long long a 	= pushed - count;
+		const int 		j 	= static_cast<int>(a % capacity);
+
+		if (type[j] == SC_TS_BID) {
+
+			at_bid_total 	-= volume[j];
+			bid_ticks		-= ticks[j];
+
+		} else {
+
+			at_ask_total	-= volume[j];
+			ask_ticks		-= ticks[j];
+
+		}
+
+		if (hi_head < hi_tail && hi_q[hi_head % capacity] == a)
+
+			hi_head++;
+
+		if (lo_head < lo_tail && lo_q[lo_head % capacity] == a)
+
+			lo_head++;
+
+		count--;
+
+	}
+
+	// p is the record's price in ticks
+
+	void push(const tick & r, const int p) {
+
+		if (count == capacity)
+
+			evict();
+
+		if (pushed == 0) {
+
+			// first trade record, initialize everything
+
+			prev_bid = p;
+			prev_ask = p;
+
+		}
+
+		const long long a 	= pushed++;
+		const int		j	= static_cast<int>(a % capacity);
+		int				t	= 0;
+
+		price[j]	= p;
+		volume[j]	= r.volume;
+		type[j]		= r.type;
+
+		if (r.type == SC_TS_BID) {
+
+			if (p < prev_bid)
+
+				t = prev_bid - p;
+
+			at_bid_total 	+= r.volume;
+			bid_ticks		+= t;
+			prev_bid		=  p;
+
+			while (lo_head < lo_tail && price[lo_q[(lo_tail - 1) % capacity] % capacity] >= p)
+
+				lo_tail--;
+
+			lo_q[lo_tail++ % capacity] = a;
+
+		} else {
+
+			if (p > prev_ask)
+
+				t = p - prev_ask;
+
+			at_ask_total	+= r.volume;
+			ask_ticks		+= t;
+			prev_ask		=  p;
+
+			while (hi_head < hi_tail && price[hi_q[(hi_tail - 1) % capacity] % capacity] <= p)
+
+				hi_tail--;
+
+			hi_q[hi_tail++ % capacity] = a;
+
+		}
+
+		ticks[j]	= t;
+		count++;
+
+	}
+
+	// same result as reset(n) followed by push() of the last n records:
+	// transposes the records into the ring and per-side arrays, takes the
+	// sums and tick increments with the batch kernels, and builds the
+	// queues from a backward scan for suffix maxima and minima.
+
+	void fill(const tick * r, int len, const int n, const tick_scale & scale) {
+
+		reset(n);
+
+		if (len > n) {
+
+			r	+= len - n;
+			len	=  n;
+
+		}
+
+		if (len == 0)
+
+			return;
+
+		for (int s = 0; s < 2; s++) {
+
+			side_p[s].resize(len);
+			side_v[s].resize(len);
+			side_i[s].resize(len);
+			side_t[s].resize(len);
+
+		}
+
+		int m[2] = { 0, 0 };
+
+		for (int i = 0; i < len; i++) {
+
+			const int p = scale.ticks(r[i].price);
+			const int s = r[i].type == SC_TS_BID ? 0 : 1;
+
+			price[i]	= p;
+			volume[i]	= r[i].volume;
+			type[i]		= r[i].type;
+
+			side_p[s][m[s]]	= p;
+			side_v[s][m[s]]	= r[i].volume;
+			side_i[s][m[s]]	= i;
+			m[s]++;
+
+		}
+
+		const int first = price[0];
+
+		at_bid_total	= batch_sum(side_v[0].data(), m[0]);
+		at_ask_total	= batch_sum(side_v[1].data(), m[1]);
+		bid_ticks		= batch_increments(side_p[0].data(), m[0], first, -1, side_t[0].data());
+		ask_ticks		= batch_increments(side_p[1].data(), m[1], first, 1, side_t[1].data());
+		prev_bid		= m[0] > 0 ? side_p[0][m[0] - 1] : first;
+		prev_ask		= m[1] > 0 ? side_p[1][m[1] - 1] : first;
+
+		for (int s = 0; s < 2; s++)
+
+			for (int k = 0; k < m[s]; k++)
+
+				ticks[side_i[s][k]] = side_t[s][k];
+
+		// queue entries are the prints strictly above (asks) or below (bids)
+		// every later print on the same side
+
+		int best = INT_MIN;
+
+		for (int k = m[1] - 1; k >= 0; k--)
+
+			if (side_p[1][k] > best) {
+
+				best = side_p[1][k];
+
+				hi_q[hi_tail++] = side_i[1][k];
+
+			}
+
+		best = INT_MAX;
+
+		for (int k = m[0] - 1; k >= 0; k--)
+
+			if (side_p[0][k] < best) {
+
+				best = side_p[0][k];
+
+				lo_q[lo_tail++] = side_i[0][k];
+
+			}
+
+		// scanned newest first; queues are oldest first
+
+		for (int i = 0, j = static_cast<int>(hi_tail) - 1; i < j; i++, j--)
+
+			std::swap(hi_q[i], hi_q[j]);
+
+		for (int i = 0, j = static_cast<int>(lo_tail) - 1; i < j; i++, j--)
+
+			std::swap(lo_q[i], lo_q[j]);
+
+		pushed	= len;
+		count	= len;
+
+	}
+
+	int first_price() 	const { return price[(pushed - count) % capacity]; }
+	int last_price() 	const { return price[(pushed - 1) % capacity]; }
+
+	// high of the ask prints and low of the bid prints; check has_range() first
+
+	bool has_range() 	const { return hi_head < hi_tail && lo_head < lo_tail; }
+	int high() 			const { return price[hi_q[hi_head % capacity] % capacity]; }
+	int low() 			const { return price[lo_q[lo_head % capacity] % capacity]; }
+
+};
+
+// batched spreadsheet writes. a process-wide shadow holds the last value
+// written to every (sheet, column, row) cell. writes that match the shadow
+// are dropped, the rest are staged and sent to the sheet in one pass by
+// flush() at the end of the study call.
+
+struct sheet_cell_key {
+
+	void *	h;
+	int		col;
+	int		row;
+
+	bool operator < (const sheet_cell_key & o) const {
+
+		if (h != o.h)		return h < o.h;
+		if (col != o.col)	return col < o.col;
+
+		return row < o.row;
+
+	}
+
+};
+
+
+struct sheet_cell {
+
+	bool		is_string	= false;
+	bool		dirty		= false;
+	double		d			= 0;
+	std::string	s;
+
+};
+
+
+std::map<sheet_cell_key, sheet_cell> sheet_shadow;
+
+// cells marked since the last flush. studies run one at a time on the ui
+// thread, so every writer shares one buffer and keeps its capacity.
+
+std::vector<std::map<sheet_cell_key, sheet_cell>::iterator> sheet_dirty;
+
+
+struct sheet_writer {
+
+	SCStudyInterfaceRef									sc;
+	void *												h;
+	std::vector<std::map<sheet_cell_key, sheet_cell>::iterator> &	dirty;
+
+	sheet_writer(SCStudyInterfaceRef sc, void * h) : sc(sc), h(h), dirty(sheet_dirty) {
+
+		if (sc.IsFullRecalculation)
+
+			// the sheet may have been edited or reloaded, forget what it holds
+
+			invalidate();
+
+	}
+
+	~sheet_writer() { flush(); }
+
+	void invalidate() {
+
+		sheet_shadow.erase(
+			sheet_shadow.lower_bound({ h, INT_MIN, INT_MIN }),
+			sheet_shadow.upper_bound({ h, INT_MAX, INT_MAX })
+		);
+
+	}
+
+	// finds the cell's shadow, inserting it only when it is new
+
+	std::pair<std::map<sheet_cell_key, sheet_cell>::iterator, bool> cell(const int col, const int row) {
+
+		const sheet_cell_key	k	= { h, col, row };
+		auto					it	= sheet_shadow.lower_bound(k);
+
+		if (it != sheet_shadow.end() && !(k < it->first))
+
+			return { it, false };
+
+		return { sheet_shadow.emplace_hint(it, k, sheet_cell()), true };
+
+	}
+
+	void set(const int col, const int row, const double d) {
+
+		auto 			it 	= cell(col, row);
+		sheet_cell &	c	= it.first->second;
+
+		if (!it.second && !c.is_string && c.d == d)
+
+			return;
+
+		c.is_string = false;
+		c.d			= d;
+
+		mark(it.first);
+
+	}
+
+	void set(const int col, const int row, const char * s) {
+
+		auto 			it 	= cell(col, row);
+		sheet_cell &	c	= it.first->second;
+
+		if (!it.second && c.is_string && c.s.compare(s) == 0)
+
+			return;
+
+		c.is_string = true;
+		c.s			= s;
+
+		mark(it.first);
+
+	}
+
+	// d as text, e.g. set(col, row, d, "%.2f")
+
+	void set(const int col, const int row, const double d, const char * format) {
+
+		char buf[32];
+
+		snprintf(buf, sizeof(buf), format, d);
+
+		set(col, row, buf);
+
+	}
+
+	void mark(const std::map<sheet_cell_key, sheet_cell>::iterator & it) {
+
+		if (it->second.dirty)
+
+			return;
+
+		it->second.dirty = true;
+
+		dirty.push_back(it);
+
+	}
+
+	void flush() {
+
+		for (auto & it : dirty) {
+
+			const sheet_cell_key &	k = it->first;
+			sheet_cell &			c = it->second;
+
+			if (c.is_string)
+
+				sc.SetSheetCellAsString(k.h, k.col, k.row, c.s.c_str());
+
+			else
+
+				sc.SetSheetCellAsDouble(k.h, k.col, k.row, c.d);
+
+			c.dirty = false;
+
+		}
+
+		dirty.clear();
+
+	}
+
+};
+
+
+// parses up to max_n comma separated integers, returns the number parsed
+
+int parse_ints(const char * s, int * out, const int max_n) {
+
+	int n = 0;
+
+	while (*s != 0 && n < max_n) {
+
+		char * end;
+		long   v = std::strtol(s, &end, 10);
+
+		if (end == s) {
+
+			// skip separators and anything unparseable
+
+			s++;
+
+			continue;
+
+		}
+
+		out[n++]	= static_cast<int>(v);
+		s			= end;
+
+	}
+
+	return n;
+
+}
+
+
+// values indexed by integer tick, stored contiguously from an anchor tick
+// set on first use. the range grows in chunks at either end, so lookups are
+// O(1) and a session's prices are normally covered by one allocation.
+
+#define LADDER_CHUNK 512
+
+template <typename T>
+struct price_ladder {
+
+	int				anchor	= 0;	// tick of values[0]
+	T				fill	= T();	// value of entries never written
+	std::vector<T>	values;
+
+	void reset(const T & fill_) {
+
+		fill = fill_;
+
+		values.clear();
+
+	}
+
+	bool contains(const int t) const { return t >= anchor && t < anchor + static_cast<int>(values.size()); }
+
+	T get(const int t) const { return contains(t) ? values[t - anchor] : fill; }
+
+	T & at(const int t) {
+
+		if (values.empty()) {
+
+			anchor = t - LADDER_CHUNK / 2;
+
+			values.assign(LADDER_CHUNK, fill);
+
+		} else if (t < anchor) {
+
+			const int n = ((anchor - t) / LADDER_CHUNK + 1) * LADDER_CHUNK;
+
+			values.insert(values.begin(), n, fill);
+
+			anchor -= n;
+
+		} else if (t >= anchor + static_cast<int>(values.size())) {
+
+			const int n = ((t - anchor - static_cast<int>(values.size())) / LADDER_CHUNK + 1) * LADDER_CHUNK;
+
+			values.resize(values.size() + n, fill);
+
+		}
+
+		return values[t - anchor];
+
+	}
+
+};
+
+
+// process-wide mirror of each symbol's market depth, shared like tick_cache.
+// acsil only exposes depth level by level, so a pull still reads every level
+// up to the deepest one an open reader asks for; the book diffs that read
+// against the previous one and keeps:
+//
+//		price / qty			per level, price in ticks
+//		cum_qty / cum_notional	prefix sums, so the top k levels cost O(1)
+//		changes				log of the levels that differed between pulls
+//
+// prices that fall outside the levels read are reported as changes to 0 with
+// out_of_view set, since they may still be resting deeper in the book.
+//
+// the change log is bounded like tick_cache: storage for DEPTH_LOG_MAX
+// changes is reserved up front and the older half is dropped when it is
+// full. readers keep absolute cursors into it, so charts that pull the same
+// symbol at different times each see every change.
+
+#define DEPTH_LOG_MAX (1 << 16)
+
+#define DEPTH_BID 0
+#define DEPTH_ASK 1
+
+struct depth_change {
+
+	char			side;			// DEPTH_BID or DEPTH_ASK
+	bool			out_of_view;	// left the levels read rather than pulled
+	int				price;			// ticks
+	int				old_qty;
+	int				new_qty;
+	unsigned int	pull;			// the book's pull that saw the change
+
+};
+
+
+struct depth_side {
+
+	int						levels	= 0;
+	std::vector<int>		price;
+	std::vector<int>		qty;
+	std::vector<long long>	cum_qty;		// cum_qty[i] = qty[0] + ... + qty[i]
+	std::vector<double>		cum_notional;	// same for price * qty, in ticks
+
+	// total quantity over the top k levels
+
+	long long total_qty(const int k) const { return k <= 0 || levels == 0 ? 0 : cum_qty[(k < levels ? k : levels) - 1]; }
+
+	// average price in ticks to fill q against this side, walking from the
+	// inside. binary search over cum_qty; false if the levels read hold
+	// less than q.
+
+	bool fill_price(const long long q, double & avg) const {
+
+		if (q <= 0 || levels == 0 || cum_qty[levels - 1] < q)
+
+			return false;
+
+		int lo = 0;
+		int hi = levels - 1;
+
+		while (lo < hi) {
+
+			const int mid = (lo + hi) / 2;
+
+			if (cum_qty[mid] < q)
+
+				lo = mid + 1;
+
+			else
+
+				hi = mid;
+
+		}
+
+		const long long	before_qty		= lo > 0 ? cum_qty[lo - 1] : 0;
+		const double	before_notional	= lo > 0 ? cum_notional[lo - 1] : 0;
+
+		avg = (before_notional + static_cast<double>(q - before_qty) * price[lo]) / q;
+
+		return true;
+
+	}
+
+};
+
+
+// what one reader needs from each pull: levels, and the qty each side must
+// reach. the reader updates it on every read.
+
+struct depth_request {
+
+	int			levels	= 0;
+	long long	cover	= 0;
+
+};
+
+
+struct depth_book {
+
+	std::string					symbol;
+	SCString					sc_symbol;			// passed to the api without a per call conversion
+	float						tick_size	= 0;	// the symbol's own, 0 until known
+	int							depth		= 0;	// levels read per pull
+	long long					cover		= 0;	// and the qty each side's pull must reach
+	unsigned int				pulls		= 0;	// bumped on every pull
+	SCDateTimeMS				pulled;
+
+	depth_side					sides[2];
+	std::vector<depth_change>	changes;			// log, see DEPTH_LOG_MAX
+	size_t						dropped		= 0;	// changes trimmed from the front
+
+	std::vector<int>			price_buf;			// reused pull buffers
+	std::vector<int>			qty_buf;
+
+	std::vector<const depth_request *>	requests;	// one per open reader
+
+};
+
+
+std::map<std::string, depth_book *> depth_books;
+
+
+depth_book * depth_book_acquire(const char * symbol, const depth_request * r) {
+
+	depth_book * & book = depth_books[symbol];
+
+	if (book == NULL) {
+
+		book 				= new depth_book();
+		book->symbol		= symbol;
+		book->sc_symbol		= symbol;
+
+		book->changes.reserve(DEPTH_LOG_MAX);
+
+	}
+
+	book->requests.push_back(r);
+
+	return book;
+
+}
+
+
+void depth_book_release(depth_book * book, const depth_request * r) {
+
+	std::vector<const depth_request *> & q = book->requests;
+
+	for (size_t i = 0; i < q.size(); i++)
+
+		if (q[i] == r) {
+
+			q.erase(q.begin() + i);
+
+			break;
+
+		}
+
+	if (!q.empty())
+
+		return;
+
+	depth_books.erase(book->symbol);
+
+	delete book;
+
+}
+
+
+void depth_book_log(depth_book * book, const depth_change & c) {
+
+	std::vector<depth_change> & log = book->changes;
+
+	if (log.size() == DEPTH_LOG_MAX) {
+
+		// full, keep the newer half without reallocating
+
+		log.erase(log.begin(), log.begin() + DEPTH_LOG_MAX / 2);
+
+		book->dropped += DEPTH_LOG_MAX / 2;
+
+	}
+
+	log.push_back(c);
+
+}
+
+
+void depth_book_pull_side(SCStudyInterfaceRef sc, depth_book * book, const int side) {
+
+	depth_side &		s 		= book->sides[side];
+	std::vector<int> &	np		= book->price_buf;
+	std::vector<int> &	nq		= book->qty_buf;
+	const SCString &	symbol	= book->sc_symbol;
+
+	const int n = side == DEPTH_BID ? sc.GetBidMarketDepthNumberOfLevelsForSymbol(symbol) : sc.GetAskMarketDepthNumberOfLevelsForSymbol(symbol);
+
+	if (static_cast<int>(np.size()) < n) {
+
+		np.resize(n);
+		nq.resize(n);
+
+	}
+
+	if (static_cast<int>(s.price.capacity()) < n) {
+
+		// a cover limited pull reads a varying number of levels, and
+		// assign only grows to the exact length
+
+		s.price.reserve(n);
+		s.qty.reserve(n);
+		s.cum_qty.reserve(n);
+		s.cum_notional.reserve(n);
+
+	}
+
+	s_MarketDepthEntry e;
+
+	int			len		= 0;
+	long long	q		= 0;
+	bool		full	= false;	// stopped with levels left unread
+
+	for (int i = 0; i < n; i++) {
+
+		if (len >= book->depth && q >= book->cover) {
+
+			// enough levels and enough size
+
+			full = len > 0;
+
+			break;
+
+		}
+
+		if (side == DEPTH_BID)
+
+			sc.GetBidMarketDepthEntryAtLevelForSymbol(symbol, e, i);
+
+		else
+
+			sc.GetAskMarketDepthEntryAtLevelForSymbol(symbol, e, i);
+
+		call_counts.levels++;
+
+		if (e.Quantity <= 0)
+
+			break;
+
+		np[len] = to_ticks(e.AdjustedPrice, book->tick_size);
+		nq[len] = static_cast<int>(e.Quantity);
+
+		q += nq[len];
+
+		len++;
+
+	}
+
+	// merge the previous and new levels, both ordered from the inside out
+
+	const char	c		= static_cast<char>(side);
+	const int 	sign 	= side == DEPTH_BID ? -1 : 1;
+	int 		i 		= 0;
+	int 		j 		= 0;
+
+	while (i < s.levels || j < len) {
+
+		const int old_key = i < s.levels ? s.price[i] * sign : INT_MAX;
+		const int new_key = j < len ? np[j] * sign : INT_MAX;
+
+		if (old_key < new_key) {
+
+			// previous level is gone
+
+			const bool out_of_view = full && old_key > np[len - 1] * sign;
+
+			depth_book_log(book, { c, out_of_view, s.price[i], s.qty[i], 0, book->pulls });
+
+			i++;
+
+		} else if (new_key < old_key) {
+
+			// new level
+
+			depth_book_log(book, { c, false, np[j], 0, nq[j], book->pulls });
+
+			j++;
+
+		} else {
+
+			if (s.qty[i] != nq[j])
+
+				depth_book_log(book, { c, false, np[j], s.qty[i], nq[j], book->pulls });
+
+			i++;
+			j++;
+
+		}
+
+	}
+
+	s.levels = len;
+
+	s.price.assign(np.begin(), np.begin() + len);
+	s.qty.assign(nq.begin(), nq.begin() + len);
+	s.cum_qty.resize(len);
+	s.cum_notional.resize(len);
+
+	double v = 0;
+
+	q = 0;
+
+	for (int k = 0; k < len; k++) {
+
+		q += s.qty[k];
+		v += static_cast<double>(s.price[k]) * s.qty[k];
+
+		s.cum_qty[k]		= q;
+		s.cum_notional[k]	= v;
+
+	}
+
+}
+
+
+// the tick size depth prices are keyed in. it belongs to the symbol, not to
+// whichever chart opened the book first, so every reader converts prices
+// with book->tick_size.
+
+float symbol_tick_size(SCStudyInterfaceRef sc, const SCString & symbol) {
+
+	if (symbol.Compare(sc.Symbol) == 0)
+
+		return sc.TickSize;
+
+	return static_cast<float>(sc.GetSymbolDataValue(SYMBOL_DATA_TICK_SIZE, symbol));
+
+}
+
+
+// pulls at most once per update, unless a reader asks for more levels or
+// size than the last pull read. each side's pull stops once it has read
+// both the levels and the cumulative qty (cover) of the largest request
+// among the open readers, so a reader that needs size only walks as deep
+// as that size, and the depth shrinks again when the deepest reader asks
+// for less or closes. nothing is pulled until the symbol's tick size is
+// known.
+
+void depth_book_update(SCStudyInterfaceRef sc, depth_book * book) {
+
+	int			levels	= 0;
+	long long	cover	= 0;
+
+	for (const depth_request * r : book->requests) {
+
+		if (r->levels > levels)
+
+			levels = r->levels;
+
+		if (r->cover > cover)
+
+			cover = r->cover;
+
+	}
+
+	if (
+		book->pulled == sc.CurrentSystemDateTimeMS	&&
+		book->pulls > 0								&&
+		levels <= book->depth						&&
+		cover <= book->cover
+	)
+
+		return;
+
+	if (book->tick_size <= 0)
+
+		book->tick_size = symbol_tick_size(sc, book->sc_symbol);
+
+	if (book->tick_size <= 0)
+
+		return;
+
+	book->depth		= levels;
+	book->cover		= cover;
+	book->pulled = sc.CurrentSystemDateTimeMS;
+	book->pulls++;
+
+	depth_book_pull_side(sc, book, DEPTH_BID);
+	depth_book_pull_side(sc, book, DEPTH_ASK);
+
+}
+
+
+// a study's handle on a depth_book. read() returns the changes since this
+// reader's previous read. resync is set on the first read and when the
+// reader fell behind the log's dropped changes; the changes are then
+// incomplete, none are returned and the reader should rebuild from the
+// level arrays.
+
+struct depth_reader {
+
+	depth_book *	book	= NULL;
+	depth_request	request;			// registered with book while open
+	size_t			cursor	= 0;		// absolute, counts the book's dropped changes
+	bool			opened	= false;	// no read since open()
+	bool			resync	= false;
+
+	~depth_reader() { close(); }
+
+	void open(const char * symbol) {
+
+		if (book != NULL && book->symbol.compare(symbol) == 0)
+
+			return;
+
+		close();
+
+		book 	= depth_book_acquire(symbol, &request);
+		opened	= true;
+
+	}
+
+	void close() {
+
+		if (book != NULL)
+
+			depth_book_release(book, &request);
+
+		book = NULL;
+
+	}
+
+	const depth_change * read(SCStudyInterfaceRef sc, const int levels, int & n, const long long cover = 0) {
+
+		request.levels	= levels;
+		request.cover	= cover;
+
+		depth_book_update(sc, book);
+
+		const size_t end = book->dropped + book->changes.size();
+
+		resync	= opened || cursor < book->dropped || cursor > end;
+		opened	= false;
+		n		= resync ? 0 : static_cast<int>(end - cursor);
+		cursor	= end;
+
+		return book->changes.data() + book->changes.size() - n;
+
+	}
+
+	const depth_side & bids() const { return book->sides[DEPTH_BID]; }
+
+	const depth_side & asks() const { return book->sides[DEPTH_ASK]; }
+
+};
+
+
+// zig-zag rotation state machine over integer tick prices. a rotation ends
+// once price retraces min_rotation ticks from the current extreme. the
+// statistics type receives callbacks at each step and has no dependency on
+// the sierra chart interface:
+//
+//		on_high(t) / on_low(t)		a new extreme was set
+//		on_trade(t, volume, type)	after extremes, for every trade
+//		on_rotation(t)				before a side change; t still describes
+//									the rotation that is ending
+//		on_update(t)				after every trade
+
+template <typename stats>
+struct rotation_tracker {
+
+	int		min_rotation	= -1;
+	int		side			= 0;
+	int		high			= INT_MIN;
+	int		low				= INT_MAX;
+	int		length			= 0;
+	stats	s;
+
+	void reset(const int min_rotation_) {
+
+		min_rotation	= min_rotation_;
+		side			= 0;
+		high			= INT_MIN;
+		low				= INT_MAX;
+		length			= 0;
+		s				= stats();
+
+	}
+
+	// returns true if the trade started a new rotation
+
+	bool update(const int p, const int volume, const int type) {
+
+		if (p > high) {
+
+			high = p;
+
+			s.on_high(*this);
+
+		}
+
+		if (p < low) {
+
+			low = p;
+
+			s.on_low(*this);
+
+		}
+
+		s.on_trade(*this, volume, type);
+
+		const int from_high = high - p;
+		const int from_low	= p - low;
+
+		if (from_high >= min_rotation) {
+
+			// in down rotation
+
+			if (side > -1) {
+
+				// from up rotation
+
+				s.on_rotation(*this);
+
+				side 	= -1;
+				low		= p;
+				length	= from_high;
+
+				s.on_update(*this);
+
+				return true;		// skip subsequent if block
+
+			} else
+
+				// continuing down rotation
+
+				length = from_high > length ? from_high : length;
+
+		}
+
+		bool changed = false;
+
+		if (from_low >= min_rotation) {
+
+			// in up rotation
+
+			if (side < 1) {
+
+				// from down rotation
+
+				s.on_rotation(*this);
+
+				side	= 1;
+				high	= p;
+				length	= from_low;
+				changed	= true;
+
+			} else
+
+				// continuing up rotation
+
+				length = from_low > length ? from_low : length;
+
+		}
+
+		s.on_update(*this);
+
+		return changed;
+
+	}
+
+	int start() const 	{ return side == 1 ? low : side == -1 ? high : 0; }
+	int end() const		{ return side == 1 ? high : side == -1 ? low : 0; }
+
+};
+
+
+// rotation statistics for several thresholds in one pass. per-threshold
+// state is laid out as parallel arrays with a fixed lane count, and the
+// update is written with selects instead of branches so the compiler can
+// vectorize it. each lane follows the same rules as rotation_tracker with
+// rotation_stats. unused lanes have an unreachable threshold.
+
+#define MAX_THRESHOLDS 8
+
+struct multi_rotation {
+
+	int k = 0;
+
+	int	min_rotation[MAX_THRESHOLDS];
+	int	side[MAX_THRESHOLDS];
+	int	high[MAX_THRESHOLDS];
+	int	low[MAX_THRESHOLDS];
+	int	length[MAX_THRESHOLDS];
+	int	count[MAX_THRESHOLDS];
+	int	len_sum[MAX_THRESHOLDS];
+	int	len_max[MAX_THRESHOLDS];
+
+	void reset(const int * thresholds, const int n) {
+
+		k = n;
+
+		for (int j = 0; j < MAX_THRESHOLDS; j++) {
+
+			min_rotation[j]	= j < n ? thresholds[j] : INT_MAX;
+			side[j]			= 0;
+			high[j]			= INT_MIN;
+			low[j]			= INT_MAX;
+			length[j]		= 0;
+			count[j]		= 0;
+			len_sum[j]		= 0;
+			len_max[j]		= 0;
+
+		}
+
+	}
+
+	void update(const int p) {
+
+		for (int j = 0; j < MAX_THRESHOLDS; j++) {
+
+			const int hi		= high[j] > p ? high[j] : p;
+			const int lo		= low[j] < p ? low[j] : p;
+			const int from_high	= hi - p;
+			const int from_low	= p - lo;
+			const int sd		= side[j];
+			const int len		= length[j];
+
+			// down rotation, and up rotation if the down block did not switch
+
+			const bool dn 			= from_high >= min_rotation[j];
+			const bool dn_switch	= dn && sd > -1;
+			const bool dn_cont		= dn && sd == -1;
+			const int  len_dn		= dn_cont && from_high > len ? from_high : len;
+
+			const bool up			= !dn_switch && from_low >= min_rotation[j];
+			const bool up_switch	= up && sd < 1;
+			const bool up_cont		= up && sd == 1;
+
+			const bool switched		= dn_switch || up_switch;
+			const int  ended		= switched && sd != 0 ? 1 : 0;
+			const int  ended_len	= dn_switch ? len : len_dn;
+
+			const int  new_len		= dn_switch ? from_high : up_switch ? from_low : up_cont && from_low > len_dn ? from_low : len_dn;
+
+			count[j]	+= ended;
+			len_sum[j]	+= ended * ended_len;
+			side[j]		=  dn_switch ? -1 : up_switch ? 1 : sd;
+			high[j]		=  up_switch ? p : hi;
+			low[j]		=  dn_switch ? p : lo;
+			length[j]	=  new_len;
+			len_max[j]	=  new_len > len_max[j] ? new_len : len_max[j];
+
+		}
+
+	}
+
+	int start(const int j) const { return side[j] == 1 ? low[j] : side[j] == -1 ? high[j] : 0; }
+
+};
+
+
+// fixed-capacity history of completed rotations, newest first. the sheet
+// only displays it, so a new rotation costs one push instead of a shift of
+// every displayed column.
+
+#define MAX_ROTATIONS 1024
+
+struct rotation_record {
+
+	int			side;
+	int			start;		// ticks
+	int			length;		// ticks
+	long long	delta;
+	long long	volume;
+
+};
+
+
+struct rotation_history {
+
+	rotation_record	records[MAX_ROTATIONS];
+	int				count	= 0;
+	int				next	= 0;
+
+	void push(const rotation_record & r) {
+
+		records[next]	= r;
+		next			= (next + 1) % MAX_ROTATIONS;
+
+		if (count < MAX_ROTATIONS)
+
+			count++;
+
+	}
+
+	// i = 0 is the most recently completed rotation
+
+	const rotation_record & at(const int i) const { return records[(next - 1 - i + MAX_ROTATIONS) % MAX_ROTATIONS]; }
+
+};
+
+
+// order_flow rotation statistics: signed and total volume since the
+// opposite extreme, plus the history of completed rotations.
+
+struct flow_rotation_stats {
+
+	long long			up_delta	= 0;
+	long long			dn_delta	= 0;
+	long long			up_volume	= 0;
+	long long			dn_volume	= 0;
+	rotation_history	history;
+
+	template <typename tracker>
+	void on_high(const tracker &) {
+
+		dn_delta 	= 0;
+		dn_volume	= 0;
+
+	}
+
+	template <typename tracker>
+	void on_low(const tracker &) {
+
+		up_delta 	= 0;
+		up_volume	= 0;
+
+	}
+
+	template <typename tracker>
+	void on_trade(const tracker &, const int volume, const int type) {
+
+		const int signed_volume = type == SC_TS_BID ? -volume : volume;
+
+		up_delta 	+= signed_volume;
+		up_volume	+= volume;
+		dn_delta	+= signed_volume;
+		dn_volume	+= volume;
+
+	}
+
+	template <typename tracker>
+	void on_rotation(const tracker & t) {
+
+		if (t.side != 0)
+
+			history.push({ t.side, t.start(), t.length, delta(t.side), volume(t.side) });
+
+	}
+
+	template <typename tracker>
+	void on_update(const tracker &) {}
+
+	long long delta(const int side) const 	{ return side == 1 ? up_delta : dn_delta; }
+	long long volume(const int side) const	{ return side == 1 ? up_volume : dn_volume; }
+
+};
+
+
+// rotation statistics: count, total and max length of completed rotations.
+// the max includes the rotation in progress.
+
+struct rotation_stats {
+
+	int			count	= 0;
+	long long	len_sum	= 0;
+	int			len_max	= 0;
+
+	template <typename tracker> void on_high(const tracker &) {}
+	template <typename tracker> void on_low(const tracker &) {}
+	template <typename tracker> void on_trade(const tracker &, const int, const int) {}
+
+	template <typename tracker>
+	void on_rotation(const tracker & t) {
+
+		if (t.side != 0) {
+
+			count	+= 1;
+			len_sum	+= t.length;
+
+		}
+
+	}
+
+	template <typename tracker>
+	void on_update(const tracker & t) {
+
+		len_max = t.length > len_max ? t.length : len_max;
+
+	}
+
+};
+
+
+// symbol -> row index for a sheet, shared by every study reading the same
+// (file, sheet). built by one scan of the symbol column; a cached row is
+// checked with a single cell read and the index is rebuilt only when that
+// check fails. a symbol that is missing triggers at most one rebuild every
+// few seconds, so a misconfigured instance cannot stall the ui thread.
+
+struct sheet_symbol_index {
+
+	std::map<std::string, int, std::less<>>	rows;	// transparent, found by const char * without a copy
+	double									built	= -1;	// time of the last scan, days
+
+};
+
+
+std::map<std::string, sheet_symbol_index> sheet_symbol_indexes;
+
+SCString sheet_symbol_text;	// reused cell read buffer
+
+
+void sheet_symbol_index_build(
+	SCStudyInterfaceRef		sc,
+	void *					h,
+	const int				col,
+	const int				max_rows,
+	sheet_symbol_index &	idx
+) {
+
+	SCString & s = sheet_symbol_text;
+
+	idx.rows.clear();
+
+	for (int i = 0; i < max_rows; i++) {
+
+		sc.GetSheetCellAsString(h, col, i, s);
+
+		if (s.GetLength() > 0)
+
+			// first occurrence wins, as with the linear scan
+
+			idx.rows.insert({ s.GetChars(), i });
+
+	}
+
+	idx.built = sc.CurrentSystemDateTime.GetAsDouble();
+
+}
+
+
+int sheet_symbol_row(
+	SCStudyInterfaceRef		sc,
+	void *					h,
+	const char *			file_name,
+	const char *			sheet_name,
+	const char *			symbol,
+	const int				col,
+	const int				max_rows
+) {
+
+	if (*symbol == 0)
+
+		return -1;
+
+	static std::string		key;					// reused, keeps its capacity between calls
+
+	key.assign(file_name).append(1, '|').append(sheet_name);
+
+	const double			retry	= 5.0 / 86400;	// seconds between rebuilds on a miss
+	sheet_symbol_index &	idx		= sheet_symbol_indexes[key];
+	SCString &				s		= sheet_symbol_text;
+
+	if (idx.built < 0)
+
+		sheet_symbol_index_build(sc, h, col, max_rows, idx);
+
+	auto it = idx.rows.find(symbol);
+
+	if (it != idx.rows.end()) {
+
+		sc.GetSheetCellAsString(h, col, it->second, s);
+
+		if (!s.Compare(symbol))
+
+			return it->second;
+
+		// layout changed
+
+		sheet_symbol_index_build(sc, h, col, max_rows, idx);
+
+	} else if (sc.CurrentSystemDateTime.GetAsDouble() - idx.built > retry)
+
+		// symbol may have been added since the last scan
+
+		sheet_symbol_index_build(sc, h, col, max_rows, idx);
+
+	it = idx.rows.find(symbol);
+
+	return it != idx.rows.end() ? it->second : -1;
+
+}
+
+
+SCSFExport scsf_order_flow(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "order_flow");
+
+	#define MAX_SYMBOL_ROWS 1000
+
+	#define input_head_col  0
+	#define input_val_col	1
+	#define stat_head_col   2
+	#define stat_val_col	3
+
+	#define symbol_row			0
+	#define trades_row			1
+	#define liq_lvls_row		2
+	#define min_rotation_row	3
+	#define num_rotations_row	4
+
+	#define liquidity_balance_row	0
+	#define delta_row				1
+	#define imbalance_row			2
+	#define ask_tick_avg_row		3
+	#define bid_tick_avg_row		4
+	#define range_density_row		5
+	#define range_row				6
+	#define net_ticks_row			7
+	#define volume_row				8
+	#define sample_row				9
+	#define rotation_side_row		10
+	#define rotation_start_row		11
+	#define rotation_length_row		12
+	#define rotation_delta_row		13
+	#define rotation_volume_row     14
+
+	// set defaults
+	
+	SCInputRef symbol_input	= sc.Input[0];
+	SCInputRef file_input	= sc.Input[1];
+	SCInputRef sheet_input	= sc.Input[2];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "order_flow";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+		sc.HideStudy 			= 1;
+
+		symbol_input.Name = "symbol";
+		symbol_input.SetString("");
+
+		file_input.Name = "file_name";
+		file_input.SetString("");
+
+		sheet_input.Name = "sheet_name";
+		sheet_input.SetString("");
+
+		return;
+
+	}
+
+	struct order_flow_state {
+
+		tas_window								window;
+		tick_reader								reader;
+		depth_reader							depth;
+		rotation_tracker<flow_rotation_stats>	rotation;
+		int										rendered	= -1;	// num_rotations last drawn
+		int										high_volume	= -1;	// normalizes volume
+
+	};
+
+	order_flow_state * state = get_state<order_flow_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	// initialize base row from the sheet's symbol index
+
+	const char * file_name	= file_input.GetString();
+	const char * sheet_name = sheet_input.GetString();
+
+	if (
+		std::strcmp(file_name, "")	== 0 ||
+		std::strcmp(sheet_name, "")	== 0
+	)
+
+		// user has not initialized the spreadsheet inputs
+
+		return;
+
+	void * h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+
+	const int base_row = sheet_symbol_row(sc, h, file_name, sheet_name, symbol_input.GetString(), input_val_col, MAX_SYMBOL_ROWS);
+
+	if (base_row < 0)
+
+		// user has not selected a symbol or spreadsheet is too large
+
+		return;
+
+	// initialize remaining inputs from spreadsheet
+
+	double d_trades			= -1.0;
+	double d_liq_lvls 		= -1.0;
+	double d_min_rotation	= -1.0;
+	double d_num_rotations  = -1.0;
+
+	sc.GetSheetCellAsDouble(h, input_val_col, base_row + trades_row, d_trades);
+	sc.GetSheetCellAsDouble(h, input_val_col, base_row + liq_lvls_row, d_liq_lvls);
+	sc.GetSheetCellAsDouble(h, input_val_col, base_row + min_rotation_row, d_min_rotation);
+	sc.GetSheetCellAsDouble(h, input_val_col, base_row + num_rotations_row, d_num_rotations);
+
+	int trades			= static_cast<int>(d_trades);
+	int liq_levels  	= static_cast<int>(d_liq_lvls);
+	int min_rotation 	= static_cast<int>(d_min_rotation); 
+	int num_rotations   = min(static_cast<int>(d_num_rotations), MAX_ROTATIONS + 1);
+	
+	const tick_scale						scale(sc);
+	tas_window &							window		= state->window;
+	tick_reader &							reader		= state->reader;
+	rotation_tracker<flow_rotation_stats> &	rotation	= state->rotation;
+	const rotation_history &				history		= rotation.s.history;
+	const tick *							ticks		= NULL;
+	int										n			= 0;
+
+	if (trades > 0) {
+
+		reader.open(sc.Symbol);
+
+		ticks = reader.read(sc, n);
+
+	}
+
+	// compute stats
+
+	int	   first_price		= 0;	// ticks
+	int	   last_price		= 0;
+	double ask_ticks		= 0.0;
+	double bid_ticks		= 0.0;
+	double at_bid_total		= 0.0;
+	double at_ask_total		= 0.0;
+	double imbalance		= 0.0;
+	double net_ticks		= 0.0;
+	double ask_tick_avg		= 0.0;
+	double bid_tick_avg		= 0.0;
+	double range			= 0.0;
+	double range_density	= 0.0;
+	double sample			= 0.0;
+
+	double delta 	= -1.0;
+	double volume	= 0.0;
+
+	bool rotation_change 	= false;
+
+	if (trades > 0) {
+
+		if (window.capacity != trades || reader.restarted) {
+
+			// refill the window from the cache's last n trades
+
+			const std::vector<tick> & all = reader.cache->ticks;
+
+			window.fill(all.data(), static_cast<int>(all.size()), trades, scale);
+
+		} else
+
+			for (int i = 0; i < n; i++)
+
+				window.push(ticks[i], scale.ticks(ticks[i].price));
+
+		// rotations
+
+		const tick *	rotation_ticks	= ticks;
+		int				rotation_n		= n;
+
+		if (rotation.min_rotation != min_rotation || reader.restarted) {
+
+			// replay the session when the threshold changes. the history is
+			// cleared, so the completed rotation columns are redrawn.
+
+			rotation.reset(min_rotation);
+
+			state->rendered = -1;
+
+			rotation_ticks	= reader.cache->ticks.data();
+			rotation_n		= static_cast<int>(reader.cache->ticks.size());
+
+		}
+
+		for (int i = 0; i < rotation_n; i++) {
+
+			const tick & t = rotation_ticks[i];
+
+			if (rotation.update(scale.ticks(t.price), t.volume, t.type))
+
+				rotation_change = true;
+
+		}
+
+	}
+
+	if (trades > 0 && window.count > 0) {
+
+		first_price 	= window.first_price();
+		last_price		= window.last_price();
+		at_bid_total	= static_cast<double>(window.at_bid_total);
+		at_ask_total	= static_cast<double>(window.at_ask_total);
+		bid_ticks		= static_cast<double>(window.bid_ticks);
+		ask_ticks		= static_cast<double>(window.ask_ticks);
+
+		// compute normalized delta
+
+		if (at_bid_total > 0.0)
+		
+			delta = at_ask_total / at_bid_total;
+
+		volume = at_bid_total + at_ask_total;
+
+		// compute normalized volume
+
+		int & high_volume = state->high_volume;
+
+		if (volume > high_volume)
+
+			high_volume = volume;
+
+		volume /= high_volume;
+
+		// compute total ticks, net imbalance		
+
+		net_ticks	= last_price - first_price;
+		imbalance	= at_ask_total - at_bid_total;
+
+		// compute average ticks
+
+		if (ask_ticks > 0)
+
+			ask_tick_avg = at_ask_total / ask_ticks;
+
+		if (bid_ticks > 0)
+
+			bid_tick_avg = at_bid_total / bid_ticks;
+
+		// compute sample (lots in num_trades)
+
+		sample = at_bid_total + at_ask_total;
+
+		if (window.has_range() && window.high() - window.low() > 0) {
+
+			range			= window.high() - window.low();
+			range_density 	= (at_ask_total + at_bid_total) / range;
+
+		}
+
+	}
+
+	// compute liquidity balance
+
+	long long	total_bids 			= 0;
+	long long	total_asks 			= 0;
+	float		liquidity_balance 	= 0;
+
+	if (liq_levels > 0) {
+
+		depth_reader &	depth		= state->depth;
+		int				changed		= 0;
+
+		depth.open(sc.Symbol);
+		depth.read(sc, liq_levels, changed);
+
+		total_bids = depth.bids().total_qty(liq_levels);
+		total_asks = depth.asks().total_qty(liq_levels);
+
+	}
+
+	// 0 with no bids read, or liq_levels off
+
+	liquidity_balance = total_bids > 0 ? static_cast<float>(total_asks) / total_bids : 0;
+
+	sheet_writer w(sc, h);
+
+	// fill spreadsheet
+
+	if (
+		rotation_change 				||
+		sc.IsFullRecalculation			||
+		state->rendered != num_rotations
+	) {
+
+		// redraw completed rotations when the displayed window changes
+
+		for (int i = 1; i < num_rotations; i++) {
+
+			const int col = stat_val_col + i;
+
+			if (i <= history.count) {
+
+				const rotation_record & r = history.at(i - 1);
+
+				w.set(col, base_row + rotation_side_row, r.side == 1 ? "up" : "dn");
+				w.set(col, base_row + rotation_start_row, scale.price(r.start));
+				w.set(col, base_row + rotation_length_row, r.length);
+				w.set(col, base_row + rotation_delta_row, static_cast<double>(r.delta));
+				w.set(col, base_row + rotation_volume_row, static_cast<double>(r.volume));
+
+			} else {
+
+				w.set(col, base_row + rotation_side_row, "");
+				w.set(col, base_row + rotation_start_row, "");
+				w.set(col, base_row + rotation_length_row, "");
+				w.set(col, base_row + rotation_delta_row, "");
+				w.set(col, base_row + rotation_volume_row, "");
+
+			}
+
+		}
+
+		state->rendered = num_rotations;
+
+	}
+
+	w.set(stat_val_col, base_row + liquidity_balance_row, liquidity_balance, "%.2f");
+	w.set(stat_val_col, base_row + delta_row, delta, "%.2f");
+	w.set(stat_val_col, base_row + imbalance_row, imbalance);
+	w.set(stat_val_col, base_row + ask_tick_avg_row, static_cast<int>(ask_tick_avg));
+	w.set(stat_val_col, base_row + bid_tick_avg_row, static_cast<int>(bid_tick_avg));
+	w.set(stat_val_col, base_row + range_density_row, static_cast<int>(range_density));
+	w.set(stat_val_col, base_row + range_row, static_cast<int>(range));
+	w.set(stat_val_col, base_row + net_ticks_row, static_cast<int>(net_ticks));
+	w.set(stat_val_col, base_row + volume_row, volume, "%.2f");
+	w.set(stat_val_col, base_row + sample_row, sample);
+	w.set(stat_val_col, base_row + rotation_side_row, rotation.side == 1 ? "up" : rotation.side == -1 ? "dn" : "");
+	w.set(stat_val_col, base_row + rotation_start_row, rotation.side != 0 ? scale.price(rotation.start()) : -1);
+	w.set(stat_val_col, base_row + rotation_length_row, rotation.length);
+	w.set(stat_val_col, base_row + rotation_delta_row, static_cast<double>(rotation.s.delta(rotation.side)));
+	w.set(stat_val_col, base_row + rotation_volume_row, static_cast<double>(rotation.s.volume(rotation.side)));
+
+	w.flush();
+
+}
+
+
+// displays the current rotation start, as well as the endpoint average and max rotations from that point.
+// the rotation input is defined in ticks.
+// "thresholds" takes up to 8 comma separated rotation sizes in ticks (e.g. 4,8,16,32), evaluated
+// together in one pass. their avg and max endpoints are output as avg_0, max_0, avg_1, max_1, ...
+// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
+// under the study settings, make sure to:
+//		
+//		- set "Chart Region" to 1
+// 		- uncheck "Draw Study Underneath Main Price Graph"
+//		- set the tick size correctly in "Value Format"
+//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
+//		- check "Value Label"
+//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+
+
+SCSFExport scsf_rotation(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "rotation");
+
+	SCInputRef min_rotation_input 	= sc.Input[0];
+	SCInputRef thresholds_input		= sc.Input[1];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "rotation";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+
+		sc.Subgraph[0].Name = "start";
+		sc.Subgraph[1].Name = "end";
+		sc.Subgraph[2].Name = "avg";
+		sc.Subgraph[3].Name = "max";
+
+		SCString fmt;
+
+		for (int j = 0; j < MAX_THRESHOLDS; j++) {
+
+			sc.Subgraph[4 + 2 * j].Name = fmt.Format("avg_%d", j);
+			sc.Subgraph[5 + 2 * j].Name = fmt.Format("max_%d", j);
+
+		}
+
+		min_rotation_input.Name = "min_rotation";
+		min_rotation_input.SetInt(0);
+
+		thresholds_input.Name = "thresholds";
+		thresholds_input.SetString("");
+
+		return;
+
+	}
+
+	struct rotation_state {
+
+		tick_reader							reader;
+		rotation_tracker<rotation_stats>	rotation;
+		multi_rotation						multi;
+		std::string							thresholds;
+
+	};
+
+	rotation_state * state = get_state<rotation_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const int 		min_rotation 	= min_rotation_input.GetInt();
+	const char *	thresholds		= thresholds_input.GetString();
+	int				threshold_vals[MAX_THRESHOLDS];
+	const int		k				= parse_ints(thresholds, threshold_vals, MAX_THRESHOLDS);
+
+	// a block that is off forgets its parameters, so turning it back on
+	// replays the session instead of resuming without the skipped ticks
+
+	if (min_rotation <= 0)
+
+		state->rotation.min_rotation = -1;
+
+	if (k == 0)
+
+		state->thresholds.clear();
+
+	if (min_rotation <= 0 && k == 0)
+
+		return;
+
+	const tick_scale					scale(sc);
+	tick_reader &						reader		= state->reader;
+	rotation_tracker<rotation_stats> &	rotation	= state->rotation;
+	multi_rotation &					multi		= state->multi;
+
+	reader.open(sc.Symbol);
+
+	int 			n		= 0;
+	const tick *	ticks	= reader.read(sc, n);
+	const tick *	all		= reader.cache->ticks.data();
+	const int		n_all	= static_cast<int>(reader.cache->ticks.size());
+
+	// replay the session when a threshold changes
+
+	if (min_rotation > 0) {
+
+		const bool 		replay		= rotation.min_rotation != min_rotation || reader.restarted;
+		const tick *	r_ticks 	= replay ? all : ticks;
+		const int		r_n			= replay ? n_all : n;
+
+		if (replay)
+
+			rotation.reset(min_rotation);
+
+		for (int i = 0; i < r_n; i++)
+
+			rotation.update(scale.ticks(r_ticks[i].price), r_ticks[i].volume, r_ticks[i].type);
+
+		const rotation_stats &	st 					= rotation.s;
+		const float 			rotation_len_avg 	= st.count > 0 ? static_cast<float>(st.len_sum) / st.count : 0;
+		const int				side				= rotation.side;
+
+		const float start 	= scale.price(rotation.start());
+		const float end     = scale.price(rotation.end());
+		const float avg 	= side == 1 ? start + rotation_len_avg * scale.tick_size : side == -1 ? start - rotation_len_avg * scale.tick_size : 0;
+		const float max 	= side == 1 ? start + st.len_max * scale.tick_size : side == -1 ? start - st.len_max * scale.tick_size : 0;
+
+		// sc.AddMessageToLog(("rotation_len_max: " + std::to_string(st.len_max)).c_str(), 1);
+
+		sc.Subgraph[0][sc.Index] = start;
+		sc.Subgraph[1][sc.Index] = end;
+		sc.Subgraph[2][sc.Index] = avg;
+		sc.Subgraph[3][sc.Index] = max;
+
+	}
+
+	if (k > 0) {
+
+		const bool 		replay		= state->thresholds.compare(thresholds) != 0 || reader.restarted;
+		const tick *	r_ticks 	= replay ? all : ticks;
+		const int		r_n			= replay ? n_all : n;
+
+		if (replay) {
+
+			multi.reset(threshold_vals, k);
+
+			state->thresholds = thresholds;
+
+		}
+
+		for (int i = 0; i < r_n; i++)
+
+			multi.update(scale.ticks(r_ticks[i].price));
+
+		for (int j = 0; j < k; j++) {
+
+			const int	side	= multi.side[j];
+			const float	start	= scale.price(multi.start(j));
+			const float	avg_len	= multi.count[j] > 0 ? static_cast<float>(multi.len_sum[j]) / multi.count[j] : 0;
+			const float	dir		= side == 1 ? scale.tick_size : side == -1 ? -scale.tick_size : 0;
+
+			sc.Subgraph[4 + 2 * j][sc.Index] = side != 0 ? start + avg_len * dir : 0;
+			sc.Subgraph[5 + 2 * j][sc.Index] = side != 0 ? start + multi.len_max[j] * dir : 0;
+
+		}
+
+	}
+
+}
+
+
+// vwap over the last n trades of a symbol. trades are held in a ring buffer
+// with running sums of price * volume and volume, and only trades not yet
+// seen by the reader are ingested. the price * volume
+// sum is rebuilt from the ring once per full turn to keep rounding from
+// accumulating over a session.
+
+struct rolling_vwap {
+
+	std::string			symbol;
+	int					capacity	= 0;
+	int					count		= 0;
+	int					next		= 0;	// ring slot for the next trade
+	int					evictions	= 0;
+
+	std::vector<float>	price;
+	std::vector<int>	volume;
+
+	double				pv_sum		= 0;
+	long long			v_sum		= 0;
+
+	void reset(const char * sym, const int n) {
+
+		symbol		= sym;
+		capacity	= n;
+		count		= 0;
+		next		= 0;
+		evictions	= 0;
+		pv_sum		= 0;
+		v_sum		= 0;
+
+		price.assign(n, 0);
+		volume.assign(n, 0);
+
+	}
+
+	void push(const float p, const int v) {
+
+		if (count == capacity) {
+
+			pv_sum 	-= static_cast<double>(price[next]) * volume[next];
+			v_sum	-= volume[next];
+
+			if (++evictions == capacity) {
+
+				// exact rebuild, amortized O(1)
+
+				evictions 	= 0;
+				pv_sum		= 0;
+
+				for (int i = 0; i < capacity; i++)
+
+					if (i != next)
+
+						pv_sum += static_cast<double>(price[i]) * volume[i];
+
+			}
+
+		} else
+
+			count++;
+
+		price[next] 	=  p;
+		volume[next]	=  v;
+		pv_sum 			+= static_cast<double>(p) * v;
+		v_sum			+= v;
+		next			=  (next + 1) % capacity;
+
+	}
+
+	void ingest(const tick * ticks, const int n, const float multiplier) {
+
+		// only the last n trades can survive in the ring
+
+		for (int i = n > capacity ? n - capacity : 0; i < n; i++)
+
+			push(ticks[i].price * multiplier, ticks[i].volume);
+
+	}
+
+	double value() const { return v_sum > 0 ? pv_sum / v_sum : 0; }
+
+};
+
+
+double vwap(
+	SCStudyInterfaceRef			sc,
+	const char *				sym,
+	const int & 				num_trades,
+	rolling_vwap &				rv,
+	tick_reader &				reader
+) {
+
+	reader.open(sym);
+
+	int 			n		= 0;
+	const tick *	ticks	= reader.read(sc, n);
+
+	if (
+		rv.capacity != num_trades 				||
+		rv.symbol.compare(sym) != 0				||
+		reader.restarted
+	) {
+
+		// inputs changed or sequence numbers restarted, refill from the cache
+
+		rv.reset(sym, num_trades);
+
+		ticks 	= reader.cache->ticks.data();
+		n		= static_cast<int>(reader.cache->ticks.size());
+
+	}
+
+	rv.ingest(ticks, n, sc.RealTimePriceMultiplier);
+
+	// sc.AddMessageToLog(("vwap (vwap_func): " + std::to_string(rv.value())).c_str(), 1);
+
+	return rv.value();
+
+}
+
+
+// computes vwap of a two-leg spread using the outright contracts
+// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
+// under the study settings, make sure to:
+//		
+//		- set "Chart Region" to 1
+// 		- uncheck "Draw Study Underneath Main Price Graph"
+//		- set the tick size correctly in "Value Format"
+//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
+//		- check "Value Label"
+//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+
+
+SCSFExport scsf_two_leg_spread_vwap(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "two_leg_spread_vwap");
+
+	SCInputRef front_leg_sym 	= sc.Input[0];
+	SCInputRef front_leg_qty 	= sc.Input[1];
+	SCInputRef back_leg_sym 	= sc.Input[2];
+	SCInputRef back_leg_qty 	= sc.Input[3];
+	SCInputRef num_trades		= sc.Input[4];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 		= "two_leg_spread_vwap";
+		sc.AutoLoop 		= 0;
+
+		sc.Subgraph[0].Name = "vwap";
+
+		front_leg_sym.Name = "front_leg_sym";
+		front_leg_sym.SetString("");
+
+		front_leg_qty.Name = "front_leg_qty";
+		front_leg_qty.SetInt(0);
+
+		back_leg_sym.Name = "back_leg_sym";
+		back_leg_sym.SetString("");
+
+		back_leg_qty.Name = "back_leg_qty";
+		back_leg_qty.SetInt(0);
+
+		num_trades.Name = "num_trades";
+		num_trades.SetInt(0);
+
+		return;
+
+	}
+
+	struct legs_vwap {
+
+		rolling_vwap	rv[2];
+		tick_reader		reader[2];
+
+	};
+
+	legs_vwap * state = get_state<legs_vwap>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * 	front_leg_sym_val 	= front_leg_sym.GetString();
+	const char * 	back_leg_sym_val	= back_leg_sym.GetString();
+	int 			front_leg_qty_val	= front_leg_qty.GetInt();
+	int				back_leg_qty_val 	= back_leg_qty.GetInt();
+	int 			num_trades_val 		= num_trades.GetInt();
+
+	if (
+		std::strcmp(front_leg_sym_val, "")	== 0 ||
+		std::strcmp(back_leg_sym_val, "")	== 0 ||
+		front_leg_qty_val 					== 0 ||
+		back_leg_qty_val					== 0 ||
+		num_trades_val 						<= 0
+	)
+
+		// study not initialized
+
+		return;
+
+	const double front_leg_vwap = vwap(sc, front_leg_sym_val, num_trades_val, state->rv[0], state->reader[0]);
+	const double back_leg_vwap	= vwap(sc, back_leg_sym_val, num_trades_val, state->rv[1], state->reader[1]);
+	const double vwap_ 			= front_leg_vwap * front_leg_qty_val + back_leg_vwap * back_leg_qty_val;
+
+	// sc.AddMessageToLog(("front_leg_vwap: " + std::to_string(front_leg_vwap)).c_str(), 1);
+	// sc.AddMessageToLog(("back_leg_vwap: " + std::to_string(back_leg_vwap)).c_str(), 1);
+	// sc.AddMessageToLog(("vwap_: " + std::to_string(vwap_)).c_str(), 1);
+
+	sc.Subgraph[0][sc.Index] = vwap_;
+
+}
+
+
+// computes vwap of a single symbol
+// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
+// under the study settings, make sure to:
+//		
+//		- set "Chart Region" to 1
+// 		- uncheck "Draw Study Underneath Main Price Graph"
+//		- set the tick size correctly in "Value Format"
+//		- choose a color for the vwap subgraphs on the "Subgraphs" tab
+//		- check "Value Label"
+//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
 
 
 SCSFExport scsf_vwap_single(SCStudyInterfaceRef sc) {
 
-	SCInputRef num_trades		= sc.Input[4];
+	study_timer timer(sc, "vwap_single");
+
+	SCInputRef num_trades		= sc.Input[4];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 		= "vwap_single";
+		sc.AutoLoop 		= 0;
+
+		sc.Subgraph[0].Name = "vwap";
+
+		num_trades.Name = "num_trades";
+		num_trades.SetInt(0);
+
+		return;
+
+	}
+
+	struct single_vwap {
+
+		rolling_vwap	rv;
+		tick_reader		reader;
+
+	};
+
+	single_vwap * state = get_state<single_vwap>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * 	sym = sc.Symbol;
+	int 			num_trades_val	= num_trades.GetInt();
+
+	if (num_trades_val <= 0)
+
+		// study not initialized
+
+		return;
+
+	sc.Subgraph[0][sc.Index] = vwap(sc, sym, num_trades_val, state->rv, state->reader);
+
+}
+
+
+// recursive least squares for y = beta * x + alpha with forgetting factor
+// lambda (0 < lambda <= 1). observations are weighted by lambda ^ age, so the
+// effective window is about 1 / (1 - lambda) updates. O(1) per update.
+
+struct rls_line {
+
+	double	w[2];		// beta, alpha
+	double	p[2][2];	// inverse information matrix
+	double	lambda	= 1;
+	double	p_max	= 0;	// bound on trace(P), the seeded trace
+
+	void reset(const double beta, const double alpha, const double p0, const double lambda_) {
+
+		w[0]	= beta;
+		w[1]	= alpha;
+		p[0][0]	= p0;
+		p[0][1]	= 0;
+		p[1][0]	= 0;
+		p[1][1]	= p0;
+		lambda	= lambda_;
+		p_max	= 2 * p0;
+
+	}
+
+	double predict(const double x) const { return w[0] * x + w[1]; }
+
+	void update(const double x, const double y) {
+
+		// h = [x, 1], ph = P * h, k = ph / (lambda + h' * ph)
+
+		const double ph0	= p[0][0] * x + p[0][1];
+		const double ph1	= p[1][0] * x + p[1][1];
+		const double d		= lambda + x * ph0 + ph1;
+		const double k0		= ph0 / d;
+		const double k1		= ph1 / d;
+		const double e		= y - predict(x);
+
+		w[0] += k0 * e;
+		w[1] += k1 * e;
+
+		// P = (P - k * ph') / lambda; P is symmetric
+
+		p[0][0] = (p[0][0] - k0 * ph0) / lambda;
+		p[0][1] = (p[0][1] - k0 * ph1) / lambda;
+		p[1][0] = p[0][1];
+		p[1][1] = (p[1][1] - k1 * ph1) / lambda;
+
+		// with lambda < 1, directions the inputs don't excite (x held flat)
+		// grow by 1 / lambda per update without bound; rescale P so the
+		// next informative update can't swing the weights
+
+		const double trace = p[0][0] + p[1][1];
+
+		if (trace > p_max) {
+
+			const double f = p_max / trace;
+
+			p[0][0] *= f;
+			p[0][1] *= f;
+			p[1][0] *= f;
+			p[1][1] *= f;
+
+		}
+
+	}
+
+};
+
+
+// m[i] / m[0] linreg; model and initial values from: https://github.com/toobrien/intraday/blob/master/charts/m1_log_reg.py
+// lambda: when > 0, beta and alpha are re-estimated online by recursive
+// least squares with this forgetting factor, seeded from the inputs. p0 is
+// the initial variance given to the seed; larger values let the first
+// observations move it further. the residual is taken before each update.
+
+SCSFExport scsf_m1_linreg(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "m1_linreg");
+
+	SCInputRef m0_sym	= sc.Input[0];
+	SCInputRef m0_0 	= sc.Input[1];
+	SCInputRef mi_0 	= sc.Input[2];
+	SCInputRef beta 	= sc.Input[3];
+	SCInputRef alpha 	= sc.Input[4];
+	SCInputRef lambda	= sc.Input[5];
+	SCInputRef p0		= sc.Input[6];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 				= "m1_linreg";
+		sc.GraphRegion 				= 0;
+		sc.AutoLoop					= 0;
+		sc.UsesMarketDepthData		= 1;
+
+		sc.Subgraph[0].Name 		= "model";
+		sc.Subgraph[0].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+		sc.Subgraph[0].LineLabel 	= LL_DISPLAY_NAME | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_VALUE;
+
+		sc.Subgraph[1].Name 		= "res";
+		sc.Subgraph[1].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+		sc.Subgraph[1].LineLabel	= LL_DISPLAY_VALUE | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_CUSTOM_VALUE_AT_Y;
+
+		sc.Subgraph[2].Name 		= "beta";
+		sc.Subgraph[2].DrawStyle 	= DRAWSTYLE_IGNORE;
+
+		sc.Subgraph[3].Name 		= "alpha";
+		sc.Subgraph[3].DrawStyle 	= DRAWSTYLE_IGNORE;
+
+		m0_sym.Name 				= "m0_sym";
+		m0_sym.SetString("");
+
+		m0_0.Name 					= "m0_0";
+		m0_0.SetFloat(0.0);
+
+		mi_0.Name 					= "mi_0";
+		mi_0.SetFloat(0.0);
+
+		beta.Name 					= "beta";
+		beta.SetFloat(0.0);
+
+		alpha.Name 					= "alpha";
+		alpha.SetFloat(0.0);
+
+		lambda.Name 				= "lambda";
+		lambda.SetFloat(0.0);
+
+		p0.Name 					= "p0";
+		p0.SetFloat(100.0);
+
+		return;
+
+	}
+
+	struct m1_linreg_state {
+
+		rls_line	rls;
+		float		seed[4]		= { 0, 0, 0, 0 };	// beta, alpha, lambda, p0 the estimator was seeded with
+		float		m0_mid		= 0;				// last pair used for an update
+		float		mi_mid		= 0;
+		SCString	m0_sym;							// m0 symbol as passed to the api
+
+	};
+
+	// ahead of the input checks, so the last call frees it even when the
+	// inputs were cleared
+
+	m1_linreg_state * state = get_state<m1_linreg_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * 	m0_sym_val 	= m0_sym.GetString();
+	float 			m0_0_val	= m0_0.GetFloat();
+	float 			mi_0_val 	= mi_0.GetFloat();
+	float 			beta_val 	= beta.GetFloat();
+	float 			alpha_val 	= alpha.GetFloat();
+	float			lambda_val	= lambda.GetFloat();
+	float			p0_val		= p0.GetFloat();
+
+	if (
+		std::strcmp(m0_sym_val, "") == 0 ||
+		m0_0_val 					== 0 ||
+		mi_0_val 					== 0 ||
+		beta_val 					== 0 ||
+		alpha_val 					== 0
+	)
+
+		// study not initialized
+
+		return;
+
+	const bool online = lambda_val > 0 && lambda_val <= 1;
+
+	if (
+		state->seed[0] != beta_val 		||
+		state->seed[1] != alpha_val 	||
+		state->seed[2] != lambda_val 	||
+		state->seed[3] != p0_val
+	) {
+
+		state->rls.reset(beta_val, alpha_val, p0_val, lambda_val);
+
+		state->seed[0]	= beta_val;
+		state->seed[1]	= alpha_val;
+		state->seed[2]	= lambda_val;
+		state->seed[3]	= p0_val;
+		state->m0_mid	= 0;
+		state->mi_mid	= 0;
+
+	}
+
+	if (state->m0_sym.Compare(m0_sym_val) != 0)
+
+		state->m0_sym = m0_sym_val;
+
+	s_MarketDepthEntry de;
+
+	float bid 		= 0.0;
+	float ask 		= 0.0;
+	float m0_mid 	= 0.0;
+	float mi_mid	= 0.0;
+	float m0_chg	= 0.0;
+	float mi_chg  	= 0.0;
+	float model_chg = 0.0;
+	float res 		= 0.0;
+
+	sc.GetBidMarketDepthEntryAtLevelForSymbol(state->m0_sym, de, 0);
+
+	bid 	= de.AdjustedPrice;
+
+	sc.GetAskMarketDepthEntryAtLevelForSymbol(state->m0_sym, de, 0);
+
+	ask		= de.AdjustedPrice;
+	m0_mid 	= (bid + ask) / 2;
+
+	call_counts.levels += 2;
+
+	sc.GetBidMarketDepthEntryAtLevel(de, 0);
+
+	bid		= de.AdjustedPrice;
+
+	sc.GetAskMarketDepthEntryAtLevel(de, 0); 
+
+	ask 	= de.AdjustedPrice;
+	mi_mid  = (bid + ask) / 2;
+
+	call_counts.levels += 2;
+
+	m0_chg 		= std::log(m0_mid / m0_0_val);
+	mi_chg 		= std::log(mi_mid / mi_0_val);
+	model_chg	= online ? static_cast<float>(state->rls.predict(m0_chg)) : m0_chg * beta_val + alpha_val;
+	res			= mi_chg - model_chg;
+
+	if (
+		online 						&&
+		m0_mid > 0 && mi_mid > 0	&&
+		(m0_mid != state->m0_mid || mi_mid != state->mi_mid)
+	) {
+
+		// new mid pair
+
+		state->rls.update(m0_chg, mi_chg);
+
+		state->m0_mid = m0_mid;
+		state->mi_mid = mi_mid;
+
+	}
+
+	sc.Subgraph[0][sc.Index] 			= mi_0_val * std::pow(M_E, model_chg);
+	sc.Subgraph[1].Data[sc.Index]		= res;
+	sc.Subgraph[1].Arrays[0][sc.Index]	= mi_0_val * std::pow(M_E, mi_chg);
+	sc.Subgraph[2][sc.Index]			= online ? static_cast<float>(state->rls.w[0]) : beta_val;
+	sc.Subgraph[3][sc.Index]			= online ? static_cast<float>(state->rls.w[1]) : alpha_val;
+
+}
+
+
+// prices any number of spread structures from one top-of-book snapshot of
+// their distinct legs. a structure is a list of leg:qty terms, e.g.
+//
+//		SR3H5:1,SR3M5:-2,SR3U5:1;ZN:2,ZB:-1
+//
+// with structures separated by ';'. every structure uses the same side
+// convention as the two leg studies:
+//
+//		bid = sum(qty * (qty > 0 ? leg ask : leg bid))
+//		ask = sum(qty * (qty > 0 ? leg bid : leg ask))
+//
+// the side each term reads is resolved when the structure is added, so
+// pricing is a gather and multiply-add over flat arrays.
+
+#define MAX_SPREAD_STRUCTURES	16	// structures with subgraphs in spread_pricer
+#define MAX_SPREAD_LEGS			16	// legs with depth in spread_state
+
+struct spread_engine {
+
+	std::vector<std::string>	symbols;	// distinct legs
+	std::vector<SCString>		sc_symbols;	// the same, as passed to the api
+	std::vector<float>			top;		// top[2 * leg + DEPTH_BID / DEPTH_ASK]
+	std::vector<int>			term_leg;
+	std::vector<int>			term_qty;
+	std::vector<int>			term_bid;	// index into top used for the structure's bid
+	std::vector<int>			term_ask;	// and its ask
+	std::vector<int>			term_structure;
+	std::vector<int>			begin		= { 0 };	// structure i is terms [begin[i], begin[i + 1])
+
+	void clear() {
+
+		symbols.clear();
+		sc_symbols.clear();
+		top.clear();
+		term_leg.clear();
+		term_qty.clear();
+		term_bid.clear();
+		term_ask.clear();
+		term_structure.clear();
+
+		begin.assign(1, 0);
+
+	}
+
+	int structures() const { return static_cast<int>(begin.size()) - 1; }
+
+	int legs() const { return static_cast<int>(symbols.size()); }
+
+	int leg(const char * symbol, const size_t len) {
+
+		for (int i = 0; i < legs(); i++)
+
+			if (symbols[i].compare(0, std::string::npos, symbol, len) == 0)
+
+				return i;
+
+		symbols.emplace_back(symbol, len);
+		sc_symbols.emplace_back(symbols.back().c_str());
+		top.resize(2 * symbols.size(), 0);
+
+		return legs() - 1;
+
+	}
+
+	void add_term(const char * symbol, const size_t len, const int qty) {
+
+		const int i = leg(symbol, len);
+
+		term_leg.push_back(i);
+		term_qty.push_back(qty);
+		term_bid.push_back(2 * i + (qty > 0 ? DEPTH_ASK : DEPTH_BID));
+		term_ask.push_back(2 * i + (qty > 0 ? DEPTH_BID : DEPTH_ASK));
+		term_structure.push_back(structures());
+
+	}
+
+	void end_structure() {
+
+		if (static_cast<int>(term_leg.size()) > begin.back())
+
+			begin.push_back(static_cast<int>(term_leg.size()));
+
+	}
+
+	// appends the structures in def; terms without a symbol or with a zero
+	// qty are skipped. returns the number of structures.
+
+	int parse(const char * def) {
+
+		const char * c = def;
+
+		while (*c != 0) {
+
+			while (*c == ' ')
+
+				c++;
+
+			const char * 	e 		= c + std::strcspn(c, ":,;");
+			size_t			len		= e - c;
+			int				qty		= 0;
+
+			while (len > 0 && c[len - 1] == ' ')
+
+				len--;
+
+			if (*e == ':') {
+
+				char * end = NULL;
+
+				qty = static_cast<int>(strtol(e + 1, &end, 10));
+				e 	= end + std::strcspn(end, ",;");
+
+			}
+
+			if (len > 0 && qty != 0)
+
+				add_term(c, len, qty);
+
+			if (*e == ';')
+
+				end_structure();
+
+			c = *e == 0 ? e : e + 1;
+
+		}
+
+		end_structure();
+
+		return structures();
+
+	}
+
+	// one read of each leg's top of book
+
+	void snapshot(SCStudyInterfaceRef sc) {
+
+		s_MarketDepthEntry de;
+
+		for (int i = 0; i < legs(); i++) {
+
+			sc.GetBidMarketDepthEntryAtLevelForSymbol(sc_symbols[i], de, 0);
+
+			top[2 * i + DEPTH_BID] = de.AdjustedPrice;
+
+			sc.GetAskMarketDepthEntryAtLevelForSymbol(sc_symbols[i], de, 0);
+
+			top[2 * i + DEPTH_ASK] = de.AdjustedPrice;
+
+		}
+
+		call_counts.levels += 2 * legs();
+
+	}
+
+	// prices every structure in one pass over all terms; bids and asks
+	// hold structures() values.
+
+	void price_all(float * bids, float * asks) const {
+
+		const int n = structures();
+		const int m = static_cast<int>(term_leg.size());
+
+		for (int i = 0; i < n; i++) {
+
+			bids[i] = 0;
+			asks[i] = 0;
+
+		}
+
+		const float *	t	= top.data();
+		const int *		tb	= term_bid.data();
+		const int *		ta	= term_ask.data();
+		const int *		tq	= term_qty.data();
+		const int *		ts	= term_structure.data();
+
+		for (int j = 0; j < m; j++) {
+
+			bids[ts[j]] += t[tb[j]] * tq[j];
+			asks[ts[j]] += t[ta[j]] * tq[j];
+
+		}
+
+	}
+
+	void price(const int i, float & bid, float & ask) const {
+
+		bid = 0;
+		ask = 0;
+
+		for (int j = begin[i]; j < begin[i + 1]; j++) {
+
+			bid += top[term_bid[j]] * term_qty[j];
+			ask += top[term_ask[j]] * term_qty[j];
+
+		}
+
+	}
+
+};
+
+
+// a spread_engine and the definition it was parsed from, reparsed when the
+// definition changes. price_size() prices structure i for size units: each
+// term walks its leg's depth for qty * size lots on the side the convention
+// assigns it, so bid and ask are average executable prices per unit.
+// each leg's depth is keyed in that leg's own ticks.
+
+struct spread_state {
+
+	spread_engine	engine;
+	std::string		def;
+	depth_reader	depth[MAX_SPREAD_LEGS];
+
+	bool price_size(SCStudyInterfaceRef sc, const int i, const int size, float & bid, float & ask) {
+
+		if (engine.legs() > MAX_SPREAD_LEGS)
+
+			return false;
+
+		double b = 0;
+		double a = 0;
+
+		for (int j = engine.begin[i]; j < engine.begin[i + 1]; j++) {
+
+			const int			l			= engine.term_leg[j];
+			const int			q			= engine.term_qty[j];
+			const long long		need		= static_cast<long long>(q > 0 ? q : -q) * size;
+			int					changed		= 0;
+
+			// only the structure's legs, and only as deep as need
+
+			depth[l].open(engine.symbols[l].c_str());
+			depth[l].read(sc, 0, changed, need);
+
+			const depth_book *	book		= depth[l].book;
+			double				bid_avg		= 0;
+			double				ask_avg		= 0;
+
+			if (book->tick_size <= 0)
+
+				// leg's tick size not known yet
+
+				return false;
+
+			if (
+				!book->sides[engine.term_bid[j] - 2 * l].fill_price(need, bid_avg) ||
+				!book->sides[engine.term_ask[j] - 2 * l].fill_price(need, ask_avg)
+			)
+
+				// not enough depth
+
+				return false;
+
+			b += bid_avg * book->tick_size * q;
+			a += ask_avg * book->tick_size * q;
+
+		}
+
+		bid = static_cast<float>(b);
+		ask = static_cast<float>(a);
+
+		return true;
+
+	}
+
+	void build(const char * def_) {
+
+		if (def.compare(def_) == 0)
+
+			return;
+
+		engine.clear();
+		engine.parse(def_);
+
+		def = def_;
+
+	}
+
+};
+
+
+// prices up to MAX_SPREAD_STRUCTURES structures (see spread_engine) on one
+// instance. subgraphs are bid_i, ask_i and mid_i for structure i.
+// size: when > 0, prices are executable averages for this many units (see
+// spread_state), and 0 when the book is too thin.
+
+SCSFExport scsf_spread_pricer(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "spread_pricer");
+
+	SCInputRef structures_input = sc.Input[0];
+	SCInputRef size_input		= sc.Input[1];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "spread_pricer";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+
+		SCString fmt;
+
+		for (int i = 0; i < MAX_SPREAD_STRUCTURES; i++) {
+
+			sc.Subgraph[3 * i].Name 		= fmt.Format("bid_%d", i);
+			sc.Subgraph[3 * i + 1].Name 	= fmt.Format("ask_%d", i);
+			sc.Subgraph[3 * i + 2].Name 	= fmt.Format("mid_%d", i);
+
+		}
+
+		structures_input.Name = "structures";
+		structures_input.SetString("");
+
+		size_input.Name = "size";
+		size_input.SetInt(0);
+
+		return;
+
+	}
+
+	spread_state * state = get_state<spread_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	spread_engine & engine = state->engine;
+
+	state->build(structures_input.GetString());
+
+	if (engine.structures() == 0)
+
+		// study not initialized
+
+		return;
+
+	const int size	= size_input.GetInt();
+	const int n 	= engine.structures() < MAX_SPREAD_STRUCTURES ? engine.structures() : MAX_SPREAD_STRUCTURES;
+
+	if (size <= 0)
+
+		engine.snapshot(sc);
+
+	for (int i = 0; i < n; i++) {
+
+		float bid = 0;
+		float ask = 0;
+
+		if (size <= 0)
+
+			engine.price(i, bid, ask);
+
+		else
+
+			state->price_size(sc, i, size, bid, ask);
+
+		sc.Subgraph[3 * i][sc.Index] 		= bid;
+		sc.Subgraph[3 * i + 1][sc.Index]	= ask;
+		sc.Subgraph[3 * i + 2][sc.Index]	= (bid + ask) / 2;
+
+	}
+
+}
+
+
+// prices a universe of spreads from one top-of-book snapshot of its legs and
+// writes them to a sheet, one row per spread: name, bid, ask, mid.
+// legs: comma separated symbols, front to back.
+// gaps: comma separated calendar gaps; "1,2" generates every consecutive and
+// every 2-apart spread (+1 front, -1 back).
+// structures: further structures in spread_engine syntax.
+
+#define MAX_UNIVERSE_GAPS 8
+
+SCSFExport scsf_spread_universe(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "spread_universe");
+
+	SCInputRef legs_input		= sc.Input[0];
+	SCInputRef gaps_input		= sc.Input[1];
+	SCInputRef structures_input	= sc.Input[2];
+	SCInputRef file_input		= sc.Input[3];
+	SCInputRef sheet_input		= sc.Input[4];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "spread_universe";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+		sc.HideStudy 			= 1;
+
+		legs_input.Name = "legs";
+		legs_input.SetString("");
+
+		gaps_input.Name = "gaps";
+		gaps_input.SetString("1");
+
+		structures_input.Name = "structures";
+		structures_input.SetString("");
+
+		file_input.Name = "file_name";
+		file_input.SetString("");
+
+		sheet_input.Name = "sheet_name";
+		sheet_input.SetString("");
+
+		return;
+
+	}
+
+	struct spread_universe_state {
+
+		spread_engine				engine;
+		std::string					legs;		// inputs the engine was built from
+		std::string					gaps;
+		std::string					structures;
+		std::vector<std::string>	names;
+		std::vector<float>			bids;
+		std::vector<float>			asks;
+		int							rows		= 0;	// spreads on the sheet
+
+	};
+
+	spread_universe_state * state = get_state<spread_universe_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * legs		= legs_input.GetString();
+	const char * gaps		= gaps_input.GetString();
+	const char * structures	= structures_input.GetString();
+	const char * file_name	= file_input.GetString();
+	const char * sheet_name	= sheet_input.GetString();
+
+	if (
+		std::strcmp(file_name, "")	== 0 ||
+		std::strcmp(sheet_name, "")	== 0
+	)
+
+		// study not initialized
+
+		return;
+
+	spread_engine & engine = state->engine;
+
+	if (
+		state->legs.compare(legs)				!= 0 ||
+		state->gaps.compare(gaps)				!= 0 ||
+		state->structures.compare(structures)	!= 0
+	) {
+
+		// rebuild: calendars from the legs and gaps, then the explicit structures
+
+		engine.clear();
+		state->names.clear();
+
+		std::vector<std::string> symbols;
+
+		for (const char * c = legs; *c != 0;) {
+
+			const char *	e = c + std::strcspn(c, ",");
+			const char *	b = c;
+
+			while (b < e && *b == ' ')
+
+				b++;
+
+			if (e > b)
+
+				symbols.emplace_back(b, e - b);
+
+			c = *e == 0 ? e : e + 1;
+
+		}
+
+		int			gap_vals[MAX_UNIVERSE_GAPS];
+		const int	num_gaps	= parse_ints(gaps, gap_vals, MAX_UNIVERSE_GAPS);
+		const int	num_legs	= static_cast<int>(symbols.size());
+
+		for (int g = 0; g < num_gaps; g++) {
+
+			for (int i = 0; i + gap_vals[g] < num_legs && gap_vals[g] > 0; i++) {
+
+				const std::string & front	= symbols[i];
+				const std::string & back	= symbols[i + gap_vals[g]];
+
+				engine.add_term(front.c_str(), front.size(), 1);
+				engine.add_term(back.c_str(), back.size(), -1);
+				engine.end_structure();
+
+				state->names.push_back(front + "-" + back);
+
+			}
+
+		}
+
+		const int generated = engine.structures();
+
+		engine.parse(structures);
+
+		for (int i = generated; i < engine.structures(); i++) {
+
+			std::string name;
+
+			for (int j = engine.begin[i]; j < engine.begin[i + 1]; j++) {
+
+				char qty[16];
+
+				snprintf(qty, sizeof(qty), ":%d", engine.term_qty[j]);
+
+				if (j > engine.begin[i])
+
+					name += ",";
+
+				name += engine.symbols[engine.term_leg[j]] + qty;
+
+			}
+
+			state->names.push_back(name);
+
+		}
+
+		state->bids.resize(engine.structures());
+		state->asks.resize(engine.structures());
+
+		state->legs			= legs;
+		state->gaps			= gaps;
+		state->structures	= structures;
+
+	}
+
+	const int n = engine.structures();
+
+	if (n == 0)
+
+		return;
+
+	engine.snapshot(sc);
+	engine.price_all(state->bids.data(), state->asks.data());
+
+	void *			h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+	sheet_writer	w(sc, h);
+
+	w.set(0, 0, "spread");
+	w.set(1, 0, "bid");
+	w.set(2, 0, "ask");
+	w.set(3, 0, "mid");
+
+	for (int i = 0; i < n; i++) {
+
+		const float bid = state->bids[i];
+		const float ask = state->asks[i];
+
+		w.set(0, i + 1, state->names[i].c_str());
+		w.set(1, i + 1, bid);
+		w.set(2, i + 1, ask);
+		w.set(3, i + 1, (bid + ask) / 2);
+
+	}
+
+	// clear rows left from a larger universe
+
+	for (int i = n; i < state->rows; i++)
+
+		for (int col = 0; col < 4; col++)
+
+			w.set(col, i + 1, "");
+
+	state->rows = n;
+
+	w.flush();
+
+}
+
+
+// computes bid, ask, and mid for a two leg spread, using the outright contracts
+// size: when > 0, bid and ask are average executable prices for that many spreads
+// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
+// under the study settings, make sure to:
+//
+//		- set "Chart Region" to 1
+// 		- uncheck "Draw Study Underneath Main Price Graph"
+//		- set the tick size correctly in "Value Format"
+//		- choose a color for each of the subgraphs on the "Subgraphs" tab
+//		- check "Value Label"
+//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+
+
+SCSFExport scsf_two_leg_spread(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "two_leg_spread");
+
+	SCInputRef front_leg_sym	= sc.Input[0];
+	SCInputRef front_leg_qty	= sc.Input[1];
+	SCInputRef back_leg_sym		= sc.Input[2];
+	SCInputRef back_leg_qty		= sc.Input[3];
+	SCInputRef size				= sc.Input[4];
+
+
+	if (sc.SetDefaults) {
+
+			sc.GraphName 			= "two_leg_spread";
+			sc.AutoLoop 			= 0;
+			sc.UsesMarketDepthData 	= 1;
+			// sc.HideStudy 			= 1;
+
+			sc.Subgraph[0].Name = "bid";
+			sc.Subgraph[1].Name = "ask";
+			sc.Subgraph[2].Name = "mid";
+
+			front_leg_sym.Name = "front_leg_sym";
+			front_leg_sym.SetString("");
+
+			front_leg_qty.Name = "front_leg_qty";
+			front_leg_qty.SetInt(0);
+
+			back_leg_sym.Name = "back_leg_sym";
+			back_leg_sym.SetString("");
+
+			back_leg_qty.Name = "back_leg_qty";
+			back_leg_qty.SetInt(0);
+
+			size.Name = "size";
+			size.SetInt(0);
+
+			return;
+
+		}
+
+	spread_state * state = get_state<spread_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * 	front_leg_sym_val 	= front_leg_sym.GetString();
+	const char * 	back_leg_sym_val	= back_leg_sym.GetString();
+	int 			front_leg_qty_val	= front_leg_qty.GetInt();
+	int				back_leg_qty_val 	= back_leg_qty.GetInt();
+
+	if (
+		std::strcmp(front_leg_sym_val, "")	== 0 ||
+		std::strcmp(back_leg_sym_val, "")	== 0 ||
+		front_leg_qty_val 					== 0 ||
+		back_leg_qty_val					== 0
+	)
+
+		// study not initialized
+
+		return;
+
+	char def[256];
+
+	float bid = 0;
+	float ask = 0;
+	float mid = 0;
+
+	// one structure: front_leg_qty * front + back_leg_qty * back
+
+	snprintf(def, sizeof(def), "%s:%d,%s:%d", front_leg_sym_val, front_leg_qty_val, back_leg_sym_val, back_leg_qty_val);
+
+	state->build(def);
+
+	if (size.GetInt() > 0) {
+
+		// executable for size spreads, walking each leg's depth
+
+		if (!state->price_size(sc, 0, size.GetInt(), bid, ask))
+
+			return;
+
+	} else {
+
+		state->engine.snapshot(sc);
+		state->engine.price(0, bid, ask);
+
+	}
+
+	mid = (bid + ask) / 2;
+
+	sc.Subgraph[0][sc.Index] = bid;
+	sc.Subgraph[1][sc.Index] = ask;
+	sc.Subgraph[2][sc.Index] = mid;
+
+}
+
+
+SCSFExport scsf_spread_offset(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "spread_offset");
+
+	SCInputRef x_sym	= sc.Input[0];
+	SCInputRef x_qty	= sc.Input[1];
+	SCInputRef y_sym	= sc.Input[2];
+	SCInputRef y_qty	= sc.Input[3];
+	SCInputRef avg 		= sc.Input[4];
+
+
+	if (sc.SetDefaults) {
+
+			sc.GraphName 			= "spread_offset";
+			sc.AutoLoop 			= 0;
+			sc.UsesMarketDepthData 	= 1;
+			// sc.HideStudy 			= 1;
+
+			sc.Subgraph[0].Name 		= "offset";
+			sc.Subgraph[0].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+			sc.Subgraph[0].LineLabel	= LL_DISPLAY_VALUE | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_CUSTOM_VALUE_AT_Y;
+
+			x_sym.Name = "x_sym";
+			x_sym.SetString("");
+
+			x_qty.Name = "x_qty";
+			x_qty.SetInt(0);
+
+			y_sym.Name = "y_sym";
+			y_sym.SetString("");
+
+			y_qty.Name = "y_qty";
+			y_qty.SetInt(0);
+
+			avg.Name = "avg";
+			avg.SetFloat(0.0);
+
+			return;
+
+		}
+
+	spread_state * state = get_state<spread_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char * 	x_sym_val 	= x_sym.GetString();
+	const char * 	y_sym_val	= y_sym.GetString();
+	int 			x_qty_val	= x_qty.GetInt();
+	int				y_qty_val 	= y_qty.GetInt();
+	float 			avg_val 	= avg.GetFloat();
+
+	if (
+		std::strcmp(x_sym_val, "")	== 0 	||
+		std::strcmp(y_sym_val, "")	== 0 	||
+		x_qty_val 					== 0 	||
+		y_qty_val					== 0	||
+		avg_val 					== 0.0
+	)
+
+		// study not initialized
+
+		return;
+
+	char def[256];
+
+	float bid 		= 0;
+	float ask 		= 0;
+	float y_mid 	= 0;
+	float offset	= 0;
+
+	// spread is y - x
+
+	snprintf(def, sizeof(def), "%s:%d,%s:%d", x_sym_val, x_qty_val, y_sym_val, y_qty_val);
+
+	state->build(def);
+
+	spread_engine & engine = state->engine;
+
+	engine.snapshot(sc);
+	engine.price(0, bid, ask);
+
+	const int	y		= engine.legs() - 1;
+	const float	y_bid	= engine.top[2 * y + DEPTH_BID];
+	const float	y_ask	= engine.top[2 * y + DEPTH_ASK];
+
+	y_mid 	= (y_bid + y_ask) / 2;
+	offset	= (bid + ask) / 2 - avg_val;
+
+	sc.Subgraph[0].Arrays[0][sc.Index]	= y_mid;
+	sc.Subgraph[0].Data[sc.Index]		= offset;
+
+}
+
+
+// resting orders above a size threshold on one side of a depth_book, in a
+// fixed-size table. updated from the book's change list, so a depth update
+// costs O(changes). a large price that finds the table full is marked in
+// ignored and counted in dropped once, until its qty falls back below the
+// threshold.
+
+#define MAX_LARGE_ORDERS		256
+#define MAX_LARGE_ORDER_EVENTS	64
+
+#define LARGE_ORDER_ADD		0
+#define LARGE_ORDER_PULL	1
+#define LARGE_ORDER_SIZE	2
+
+struct large_order_side {
+
+	int					count	= 0;
+	int					dropped	= 0;	// prices ignored because the table was full
+	int					price[MAX_LARGE_ORDERS];
+	int					qty[MAX_LARGE_ORDERS];
+	price_ladder<char>	ignored;
+
+	void clear() {
+
+		count	= 0;
+		dropped	= 0;
+
+		ignored.reset(0);
+
+	}
+
+	int find(const int p) const {
+
+		for (int i = 0; i < count; i++)
+
+			if (price[i] == p)
+
+				return i;
+
+		return -1;
+
+	}
+
+	void set(const int p, const int q) {
+
+		int i = find(p);
+
+		if (i < 0) {
+
+			if (count == MAX_LARGE_ORDERS) {
+
+				char & d = ignored.at(p);
+
+				if (d == 0) {
+
+					d = 1;
+
+					dropped++;
+
+				}
+
+				return;
+
+			}
+
+			i = count++;
+
+		}
+
+		price[i]	= p;
+		qty[i]		= q;
+
+	}
+
+	void remove(const int p) {
+
+		const int i = find(p);
+
+		if (i < 0) {
+
+			if (ignored.get(p) != 0)
+
+				ignored.at(p) = 0;
+
+			return;
+
+		}
+
+		count--;
+
+		price[i]	= price[count];
+		qty[i]		= qty[count];
+
+	}
+
+};
+
+
+struct large_order_event {
+
+	char	side;	// DEPTH_BID or DEPTH_ASK
+	char	kind;	// LARGE_ORDER_ADD, _PULL or _SIZE
+	int		price;	// ticks
+	int		old_qty;
+	int		new_qty;
+
+};
+
+
+// large resting orders, the most recent add/pull/size-change events, and the
+// distance from the inside to the daily high and low.
+// threshold: minimum quantity of a large order.
+// max_outputs: rows of orders and events written to the sheet.
+// liq_levels: levels on each side for the liquidity balance.
+// log_events: also write every event to the message log.
+// depth_levels: levels on each side pulled for large orders, at least
+// liq_levels; orders beyond the levels read leave the table without an
+// event. deeper levels are seen too while another study reads them.
+//
+// sheet layout, with a header on row 0:
+//		0 - 2	bid price, qty, ticks from the best bid
+//		3 - 5	ask price, qty, ticks from the best ask
+//		7 - 8	stat name, value
+//		10 - 14	event side, kind, price, old qty, new qty; newest first
+
+SCSFExport scsf_large_orders(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "large_orders");
+
+	#define bid_lvls_col	0
+	#define bid_qtys_col   	1
+	#define bid_tics_col    2
+	#define ask_lvls_col 	3
+	#define ask_qtys_col   	4
+	#define ask_tics_col	5
+	#define lo_stat_head_col	7
+	#define lo_stat_val_col		8
+	#define event_col			10
+
+	#define lo_from_high_row			0
+	#define lo_from_low_row				1
+	#define lo_liquidity_balance_row	2
+	#define lo_dropped_row				3
+
+	SCInputRef file_input			= sc.Input[0];
+	SCInputRef sheet_input			= sc.Input[1];
+	SCInputRef threshold_input		= sc.Input[2];
+	SCInputRef max_outputs_input	= sc.Input[3];
+	SCInputRef liq_levels_input		= sc.Input[4];
+	SCInputRef log_events_input		= sc.Input[5];
+	SCInputRef depth_levels_input	= sc.Input[6];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "large_orders";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+		sc.HideStudy 			= 1;
+
+		file_input.Name = "file_name";
+		file_input.SetString("");
+
+		sheet_input.Name = "sheet_name";
+		sheet_input.SetString("");
+
+		threshold_input.Name = "threshold";
+		threshold_input.SetInt(0);
+
+		max_outputs_input.Name = "max_outputs";
+		max_outputs_input.SetInt(10);
+
+		liq_levels_input.Name = "liq_levels";
+		liq_levels_input.SetInt(10);
+
+		log_events_input.Name = "log_events";
+		log_events_input.SetYesNo(0);
+
+		depth_levels_input.Name = "depth_levels";
+		depth_levels_input.SetInt(40);
+
+		return;
+
+	}
+
+	struct large_orders_state {
+
+		depth_reader		depth;
+		large_order_side	sides[2];
+		large_order_event	events[MAX_LARGE_ORDER_EVENTS];
+		int					num_events	= 0;
+		int					next_event	= 0;
+		int					threshold	= -1;	// threshold the table was built with
+		int					levels		= -1;	// and levels pulled
+
+	};
+
+	large_orders_state * state = get_state<large_orders_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
+	const char *	file_name	= file_input.GetString();
+	const char *	sheet_name	= sheet_input.GetString();
+	const int		threshold	= threshold_input.GetInt();
+	const int		liq_levels	= liq_levels_input.GetInt();
+	const bool		log_events	= log_events_input.GetYesNo() != 0;
+	int				max_outputs	= max_outputs_input.GetInt();
+	int				levels		= depth_levels_input.GetInt();
+
+	if (
+		std::strcmp(file_name, "")	== 0 ||
+		std::strcmp(sheet_name, "")	== 0 ||
+		threshold 					<= 0 ||
+		max_outputs 				<= 0
+	)
+
+		// user has not properly initialized the study
+
+		return;
 
-	if (sc.SetDefaults) {
+	if (max_outputs > MAX_LARGE_ORDER_EVENTS)
 
-		sc.GraphName 		= "vwap_single";
-		sc.AutoLoop 		= 0;
+		max_outputs = MAX_LARGE_ORDER_EVENTS;
 
-		sc.Subgraph[0].Name = "vwap";
+	// track large orders from the book's changes, only as deep as asked so
+	// the shared book is not held at the full depth
 
-		num_trades.Name = "num_trades";
-		num_trades.SetInt(0);
+	if (levels < liq_levels)
+
+		levels = liq_levels;
+
+	depth_reader &			depth	= state->depth;
+	large_order_side *		sides	= state->sides;
+	int						n		= 0;
+
+	depth.open(sc.Symbol);
+
+	const depth_change * changes = depth.read(sc, levels, n);
+
+	if (depth.book->tick_size <= 0)
+
+		// no depth yet
 
 		return;
 
+	// book prices are in the symbol's ticks
+
+	const tick_scale scale(depth.book->tick_size, sc.RealTimePriceMultiplier);
+
+	if (depth.resync || state->threshold != threshold || state->levels != levels) {
+
+		// rebuild from the levels, without events
+
+		state->threshold	= threshold;
+		state->levels		= levels;
+
+		for (int s = 0; s < 2; s++) {
+
+			const depth_side & d = depth.book->sides[s];
+
+			sides[s].clear();
+
+			for (int i = 0; i < d.levels; i++)
+
+				if (d.qty[i] > threshold)
+
+					sides[s].set(d.price[i], d.qty[i]);
+
+		}
+
+		n = 0;
+
 	}
 
-	const char * 	sym = sc.Symbol;
-	int 			num_trades_val	= num_trades.GetInt();
+	for (int i = 0; i < n; i++) {
 
-	if (num_trades_val == 0)
+		const depth_change &	c 			= changes[i];
+		large_order_side &		s			= sides[static_cast<int>(c.side)];
+		const bool				was_large	= c.old_qty > threshold;
+		const bool				is_large	= c.new_qty > threshold;
 
-		// study not initialized
+		if (!was_large && !is_large)
 
-		return;
+			continue;
 
-	sc.Subgraph[0][sc.Index] = vwap(sc, sym, num_trades_val);
+		if (is_large)
 
-}
+			s.set(c.price, c.new_qty);
 
+		else
 
-// m[i] / m[0] linreg; model and initial values from: https://github.com/toobrien/intraday/blob/master/charts/m1_log_reg.py
+			s.remove(c.price);
 
-SCSFExport scsf_m1_linreg(SCStudyInterfaceRef sc) {
+		if (c.out_of_view)
 
-	SCInputRef m0_sym	= sc.Input[0];
-	SCInputRef m0_0 	= sc.Input[1];
-	SCInputRef mi_0 	= sc.Input[2];
-	SCInputRef beta 	= sc.Input[3];
-	SCInputRef alpha 	= sc.Input[4];
+			// moved past the levels read, not an event
 
-	if (sc.SetDefaults) {
+			continue;
 
-		sc.GraphName 				= "m1_linreg";
-		sc.GraphRegion 				= 0;
-		sc.AutoLoop					= 0;
-		sc.UsesMarketDepthData		= 1;
+		char kind = LARGE_ORDER_SIZE;
 
-		sc.Subgraph[0].Name 		= "model";
-		sc.Subgraph[0].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
-		sc.Subgraph[0].LineLabel 	= LL_DISPLAY_NAME | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_VALUE;
+		if (!was_large)
 
-		sc.Subgraph[1].Name 		= "res";
-		sc.Subgraph[1].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
-		sc.Subgraph[1].LineLabel	= LL_DISPLAY_VALUE | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_CUSTOM_VALUE_AT_Y;
+			kind = LARGE_ORDER_ADD;
 
-		m0_sym.Name 				= "m0_sym";
-		m0_sym.SetString("");
+		else if (c.new_qty == 0)
 
-		m0_0.Name 					= "m0_0";
-		m0_0.SetFloat(0.0);
+			kind = LARGE_ORDER_PULL;
 
-		mi_0.Name 					= "mi_0";
-		mi_0.SetFloat(0.0);
+		large_order_event & e = state->events[state->next_event];
 
-		beta.Name 					= "beta";
-		beta.SetFloat(0.0);
+		e = { c.side, kind, c.price, c.old_qty, c.new_qty };
 
-		alpha.Name 					= "alpha";
-		alpha.SetFloat(0.0);
+		state->next_event = (state->next_event + 1) % MAX_LARGE_ORDER_EVENTS;
 
-		return;
+		if (state->num_events < MAX_LARGE_ORDER_EVENTS)
+
+			state->num_events++;
+
+		if (log_events) {
+
+			SCString fmt;
+
+			sc.AddMessageToLog(
+				fmt.Format(
+					"large_orders %s %s %s %.4f %d -> %d",
+					sc.Symbol.GetChars(),
+					c.side == DEPTH_BID ? "bid" : "ask",
+					kind == LARGE_ORDER_ADD ? "add" : kind == LARGE_ORDER_PULL ? "pull" : "size",
+					scale.price(c.price),
+					c.old_qty,
+					c.new_qty
+				),
+				0
+			);
+
+		}
 
 	}
 
-	const char * 	m0_sym_val 	= m0_sym.GetString();
-	float 			m0_0_val	= m0_0.GetFloat();
-	float 			mi_0_val 	= mi_0.GetFloat();
-	float 			beta_val 	= beta.GetFloat();
-	float 			alpha_val 	= alpha.GetFloat();
+	// stats
 
-	if (
-		std::strcmp(m0_sym_val, "") == 0 ||
-		m0_0_val 					== 0 ||
-		mi_0_val 					== 0 ||
-		beta_val 					== 0 ||
-		alpha_val 					== 0
-	)
+	const depth_side &	bids		= depth.bids();
+	const depth_side &	asks		= depth.asks();
+	int					from_high	= -1;
+	int					from_low	= -1;
 
-		// study not initialized
+	if (asks.levels > 0 && sc.DailyHigh != 0)
 
-		return;
+		from_high = scale.adjusted_ticks(sc.DailyHigh) - asks.price[0];
 
-	s_MarketDepthEntry de;
+	if (bids.levels > 0 && sc.DailyLow != 0)
 
-	float bid 		= 0.0;
-	float ask 		= 0.0;
-	float m0_mid 	= 0.0;
-	float mi_mid	= 0.0;
-	float m0_chg	= 0.0;
-	float mi_chg  	= 0.0;
-	float model_chg = 0.0;
-	float res 		= 0.0;
+		from_low = bids.price[0] - scale.adjusted_ticks(sc.DailyLow);
 
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(m0_sym_val, de, 0);
+	const long long	total_bids			= bids.total_qty(liq_levels);
+	const float		liquidity_balance	= total_bids > 0 ? static_cast<float>(asks.total_qty(liq_levels)) / total_bids : 0;
 
-	bid 	= de.AdjustedPrice;
+	// fill spreadsheet
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(m0_sym_val, de, 0);
+	void *			h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+	sheet_writer	w(sc, h);
 
-	ask		= de.AdjustedPrice;
-	m0_mid 	= (bid + ask) / 2;
+	w.set(bid_lvls_col, 0, "bid");
+	w.set(bid_qtys_col, 0, "qty");
+	w.set(bid_tics_col, 0, "ticks");
+	w.set(ask_lvls_col, 0, "ask");
+	w.set(ask_qtys_col, 0, "qty");
+	w.set(ask_tics_col, 0, "ticks");
+	w.set(lo_stat_head_col, 0, "stat");
+	w.set(event_col, 0, "event");
 
-	sc.GetBidMarketDepthEntryAtLevel(de, 0);
+	w.set(lo_stat_head_col, 1 + lo_from_high_row, "from_high");
+	w.set(lo_stat_head_col, 1 + lo_from_low_row, "from_low");
+	w.set(lo_stat_head_col, 1 + lo_liquidity_balance_row, "liquidity_balance");
+	w.set(lo_stat_head_col, 1 + lo_dropped_row, "dropped");
 
-	bid		= de.AdjustedPrice;
+	w.set(lo_stat_val_col, 1 + lo_from_high_row, from_high);
+	w.set(lo_stat_val_col, 1 + lo_from_low_row, from_low);
+	w.set(lo_stat_val_col, 1 + lo_liquidity_balance_row, liquidity_balance, "%.2f");
+	w.set(lo_stat_val_col, 1 + lo_dropped_row, sides[DEPTH_BID].dropped + sides[DEPTH_ASK].dropped);
 
-	sc.GetAskMarketDepthEntryAtLevel(de, 0); 
+	// large orders, closest to the inside first
 
-	ask 	= de.AdjustedPrice;
-	mi_mid  = (bid + ask) / 2;
+	for (int s = 0; s < 2; s++) {
 
-	m0_chg 		= std::log(m0_mid / m0_0_val);
-	mi_chg 		= std::log(mi_mid / mi_0_val);
-	model_chg	= m0_chg * beta_val + alpha_val;
-	res			= mi_chg - model_chg;
+		const large_order_side &	lo		= sides[s];
+		const int					col		= s == DEPTH_BID ? bid_lvls_col : ask_lvls_col;
+		const int					sign	= s == DEPTH_BID ? -1 : 1;
+		const int					inside	= s == DEPTH_BID ? (bids.levels > 0 ? bids.price[0] : 0) : (asks.levels > 0 ? asks.price[0] : 0);
+		int							prev	= INT_MIN;
 
-	sc.Subgraph[0][sc.Index] 			= mi_0_val * std::pow(M_E, model_chg);
-	sc.Subgraph[1].Data[sc.Index]		= res;
-	sc.Subgraph[1].Arrays[0][sc.Index]	= mi_0_val * std::pow(M_E, mi_chg);
+		for (int row = 1; row <= max_outputs; row++) {
 
-}
+			// next closest price after prev; the table is small and unordered
 
+			int best = -1;
 
-// computes bid, ask, and mid for a two leg spread, using the outright contracts
-// display on the DOM using this procedure: https://www.sierrachart.com/index.php?page=doc/ChartStudies.html#NameValueLabels
-// under the study settings, make sure to:
+			for (int i = 0; i < lo.count; i++) {
+
+				const int k = lo.price[i] * sign;
+
+				if (k > prev && (best < 0 || k < lo.price[best] * sign))
+
+					best = i;
+
+			}
+
+			if (best < 0) {
+
+				w.set(col, row, "");
+				w.set(col + 1, row, "");
+				w.set(col + 2, row, "");
+
+				continue;
+
+			}
+
+			prev = lo.price[best] * sign;
+
+			w.set(col, row, scale.price(lo.price[best]));
+			w.set(col + 1, row, lo.qty[best]);
+			w.set(col + 2, row, (lo.price[best] - inside) * sign);
+
+		}
+
+	}
+
+	// events, newest first
+
+	for (int row = 1; row <= max_outputs; row++) {
+
+		if (row > state->num_events) {
+
+			for (int k = 0; k < 5; k++)
+
+				w.set(event_col + k, row, "");
+
+			continue;
+
+		}
+
+		const large_order_event & e = state->events[(state->next_event - row + MAX_LARGE_ORDER_EVENTS) % MAX_LARGE_ORDER_EVENTS];
+
+		w.set(event_col, row, e.side == DEPTH_BID ? "bid" : "ask");
+		w.set(event_col + 1, row, e.kind == LARGE_ORDER_ADD ? "add" : e.kind == LARGE_ORDER_PULL ? "pull" : "size");
+		w.set(event_col + 2, row, scale.price(e.price));
+		w.set(event_col + 3, row, e.old_qty);
+		w.set(event_col + 4, row, e.new_qty);
+
+	}
+
+	w.flush();
+
+}
+
+// likely icebergs: prices where trades are followed by the displayed size
+// being replenished. each update makes one pass over the new trades, adding
+// their volume to the traded price, then one pass over the book's changes,
+// comparing the displayed size with what the trades should have left:
 //
-//		- set "Chart Region" to 1
-// 		- uncheck "Draw Study Underneath Main Price Graph"
-//		- set the tick size correctly in "Value Format"
-//		- choose a color for each of the subgraphs on the "Subgraphs" tab
-//		- check "Value Label"
-//		- set "Draw Style" to "Subgraph Name and Value Labels Only"
+//		expected	= max(old qty - traded, 0)
+//		refill		= new qty - expected, when positive
+//
+// time and sales and depth arrive out of step, so traded volume waits up to
+// ICEBERG_MATCH_SECONDS for a depth change at its price; only a seen change
+// counts as a refill. refills accumulate per price as the estimated hidden
+// size, and a price with no refill for expire_minutes starts over and drops
+// off the flagged list. when the list is full the stalest flag is evicted;
+// an evicted price is flagged again at its next refill.
 
+#define MAX_ICEBERGS			32
+#define ICEBERG_LEVELS			5		// depth read around the inside
+#define ICEBERG_MATCH_SECONDS	2.0
 
-SCSFExport scsf_two_leg_spread(SCStudyInterfaceRef sc) {
+struct iceberg_level {
 
-	SCInputRef front_leg_sym	= sc.Input[0];
-	SCInputRef front_leg_qty	= sc.Input[1];
-	SCInputRef back_leg_sym		= sc.Input[2];
-	SCInputRef back_leg_qty		= sc.Input[3];
+	int		traded		= 0;	// volume waiting for a depth change
+	double	traded_at	= 0;	// time of the first waiting trade
+	int		hidden		= 0;	// accumulated refills
+	int		refills		= 0;
+	double	first		= 0;	// time of the first and last refill
+	double	last		= 0;
 
+};
 
-	if (sc.SetDefaults) {
 
-			sc.GraphName 			= "two_leg_spread";
-			sc.AutoLoop 			= 0;
-			sc.UsesMarketDepthData 	= 1;
-			// sc.HideStudy 			= 1;
+struct iceberg_side {
 
-			sc.Subgraph[0].Name = "bid";
-			sc.Subgraph[1].Name = "ask";
-			sc.Subgraph[2].Name = "mid";
+	price_ladder<iceberg_level>	levels;
+	std::vector<int>			touched;			// prices with traded volume waiting
+	int							flagged[MAX_ICEBERGS];
+	int							num_flagged	= 0;
 
-			front_leg_sym.Name = "front_leg_sym";
-			front_leg_sym.SetString("");
+	void reset() {
 
-			front_leg_qty.Name = "front_leg_qty";
-			front_leg_qty.SetInt(0);
+		levels.reset(iceberg_level());
+		touched.clear();
 
-			back_leg_sym.Name = "back_leg_sym";
-			back_leg_sym.SetString("");
+		num_flagged = 0;
 
-			back_leg_qty.Name = "back_leg_qty";
-			back_leg_qty.SetInt(0);
+	}
 
-			return;
+	int find(const int p) const {
+
+		for (int i = 0; i < num_flagged; i++)
+
+			if (flagged[i] == p)
+
+				return i;
+
+		return -1;
+
+	}
+
+	// returns true when the price becomes flagged. expiry is in days.
+
+	bool refill(const int p, const int q, const double now, const int min_refills, const double expiry) {
+
+		iceberg_level & l = levels.at(p);
+
+		if (l.refills > 0 && now - l.last > expiry) {
+
+			// stale, start over and drop its flag, which expire() would
+			// no longer see once last is updated
+
+			const int i = find(p);
+
+			if (i >= 0)
+
+				flagged[i] = flagged[--num_flagged];
+
+			l.refills	= 0;
+			l.hidden	= 0;
 
 		}
 
-	const char * 	front_leg_sym_val 	= front_leg_sym.GetString();
-	const char * 	back_leg_sym_val	= back_leg_sym.GetString();
-	int 			front_leg_qty_val	= front_leg_qty.GetInt();
-	int				back_leg_qty_val 	= back_leg_qty.GetInt();
+		if (l.refills == 0)
 
-	if (
-		std::strcmp(front_leg_sym_val, "")	== 0 ||
-		std::strcmp(back_leg_sym_val, "")	== 0 ||
-		front_leg_qty_val 					== 0 ||
-		back_leg_qty_val					== 0
-	)
+			l.first = now;
+
+		l.hidden += q;
+		l.last    = now;
+
+		if (++l.refills < min_refills || find(p) >= 0)
+
+			return false;
+
+		int k = num_flagged;
+
+		if (num_flagged == MAX_ICEBERGS) {
+
+			// full, replace the flag with the oldest refill
+
+			k = 0;
+
+			for (int i = 1; i < num_flagged; i++)
+
+				if (level(flagged[i]).last < level(flagged[k]).last)
+
+					k = i;
+
+		} else
+
+			num_flagged++;
+
+		flagged[k] = p;
+
+		return true;
+
+	}
+
+	// drops flags with no refill within expiry (days)
+
+	void expire(const double now, const double expiry) {
+
+		for (int i = 0; i < num_flagged;) {
+
+			if (now - level(flagged[i]).last > expiry)
+
+				flagged[i] = flagged[--num_flagged];
+
+			else
+
+				i++;
+
+		}
+
+	}
+
+	// drops traded volume that found no depth change in time
+
+	void expire_trades(const double now) {
+
+		size_t k = 0;
+
+		for (size_t i = 0; i < touched.size(); i++) {
+
+			iceberg_level & l = levels.at(touched[i]);
+
+			if (l.traded > 0 && now - l.traded_at > ICEBERG_MATCH_SECONDS / 86400)
+
+				l.traded = 0;
+
+			if (l.traded > 0)
+
+				touched[k++] = touched[i];
+
+		}
+
+		touched.resize(k);
+
+	}
+
+	const iceberg_level & level(const int p) const { return levels.values[p - levels.anchor]; }
+
+};
+
+
+// min_refills: refills before a price is reported as an iceberg.
+// log_icebergs: write newly flagged prices to the message log.
+// subgraphs give the flagged bid and ask with the largest estimated hidden
+// size: price, hidden size, refill count and refills per minute.
+
+SCSFExport scsf_icebergs(SCStudyInterfaceRef sc) {
+
+	study_timer timer(sc, "icebergs");
+
+	SCInputRef min_refills_input	= sc.Input[0];
+	SCInputRef log_input			= sc.Input[1];
+	SCInputRef expire_input			= sc.Input[2];
+
+	if (sc.SetDefaults) {
+
+		sc.GraphName 			= "icebergs";
+		sc.AutoLoop 			= 0;
+		sc.UsesMarketDepthData 	= 1;
+
+		const char * names[8] = {
+			"bid_price", "bid_hidden", "bid_refills", "bid_refill_rate",
+			"ask_price", "ask_hidden", "ask_refills", "ask_refill_rate"
+		};
+
+		for (int i = 0; i < 8; i++) {
+
+			sc.Subgraph[i].Name 		= names[i];
+			sc.Subgraph[i].DrawStyle	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+			sc.Subgraph[i].LineLabel	= LL_DISPLAY_NAME | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_VALUE;
+
+		}
 
-		// study not initialized
+		min_refills_input.Name = "min_refills";
+		min_refills_input.SetInt(3);
 
-		return;
+		log_input.Name = "log_icebergs";
+		log_input.SetYesNo(0);
 
-	
-	s_MarketDepthEntry de;
+		expire_input.Name = "expire_minutes";
+		expire_input.SetInt(15);
 
-	float bid 		= 0;
-	float ask 		= 0;
-	float mid 		= 0;
-	float front_bid = 0;
-	float front_ask = 0;
-	float back_bid 	= 0;
-	float back_ask 	= 0;
+		return;
 
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(front_leg_sym_val, de, 0);
+	}
 
-	front_bid = de.AdjustedPrice;
+	struct icebergs_state {
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(front_leg_sym_val, de, 0);
+		tick_reader		reader;
+		depth_reader	depth;
+		iceberg_side	sides[2];
+		bool			primed	= false;	// history skipped
 
-	front_ask = de.AdjustedPrice;
-	
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(back_leg_sym_val, de, 0);
+	};
 
-	back_bid = de.AdjustedPrice;
+	icebergs_state * state = get_state<icebergs_state>(sc, 0);
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(back_leg_sym_val, de, 0);
+	if (state == NULL)
 
-	back_ask = de.AdjustedPrice;
+		// last call, state has been released
 
-	if (back_leg_qty_val < 0) {
+		return;
 
-		// + front - back
+	const int			min_refills	= min_refills_input.GetInt();
+	const double		expiry		= expire_input.GetInt() / 1440.0;	// days
+	const double		now			= sc.CurrentSystemDateTime.GetAsDouble();
+	iceberg_side *	sides		= state->sides;
+	int				n			= 0;
+	int				changed		= 0;
 
-		bid = front_ask * front_leg_qty_val + back_bid * back_leg_qty_val;
-		ask = front_bid * front_leg_qty_val + back_ask * back_leg_qty_val;
+	if (min_refills <= 0)
 
-	} else {
+		return;
 
-		// - front + back
+	state->reader.open(sc.Symbol);
+	state->depth.open(sc.Symbol);
 
-		bid = front_bid * front_leg_qty_val + back_ask * back_leg_qty_val;
-		ask = front_ask * front_leg_qty_val + back_bid * back_leg_qty_val;
+	const tick *			ticks	= state->reader.read(sc, n);
+	const depth_change *	changes	= state->depth.read(sc, ICEBERG_LEVELS, changed);
 
-	}
+	if (state->depth.book->tick_size <= 0)
 
-	mid = (bid + ask) / 2;
+		// no depth yet
 
-	sc.Subgraph[0][sc.Index] = bid;
-	sc.Subgraph[1][sc.Index] = ask;
-	sc.Subgraph[2][sc.Index] = mid;
+		return;
 
-}
+	// trades are keyed in the book's ticks so they land on its price keys
 
+	const tick_scale scale(state->depth.book->tick_size, sc.RealTimePriceMultiplier);
 
-SCSFExport scsf_spread_offset(SCStudyInterfaceRef sc) {
+	if (!state->primed || state->reader.restarted) {
 
-	SCInputRef x_sym	= sc.Input[0];
-	SCInputRef x_qty	= sc.Input[1];
-	SCInputRef y_sym	= sc.Input[2];
-	SCInputRef y_qty	= sc.Input[3];
-	SCInputRef avg 		= sc.Input[4];
+		// trades before the study was loaded or before a restart can't
+		// be matched with the book
 
+		sides[DEPTH_BID].reset();
+		sides[DEPTH_ASK].reset();
 
-	if (sc.SetDefaults) {
+		state->primed = true;
 
-			sc.GraphName 			= "spread_offset";
-			sc.AutoLoop 			= 0;
-			sc.UsesMarketDepthData 	= 1;
-			// sc.HideStudy 			= 1;
+		return;
 
-			sc.Subgraph[0].Name 		= "offset";
-			sc.Subgraph[0].DrawStyle 	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
-			sc.Subgraph[0].LineLabel	= LL_DISPLAY_VALUE | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_CUSTOM_VALUE_AT_Y;
+	}
 
-			x_sym.Name = "x_sym";
-			x_sym.SetString("");
+	// trades
 
-			x_qty.Name = "x_qty";
-			x_qty.SetInt(0);
+	for (int i = 0; i < n; i++) {
 
-			y_sym.Name = "y_sym";
-			y_sym.SetString("");
+		const tick &	t	= ticks[i];
+		iceberg_side &	s	= sides[t.type == SC_TS_BID ? DEPTH_BID : DEPTH_ASK];
+		const int		p	= scale.ticks(t.price);
+		iceberg_level &	l	= s.levels.at(p);
 
-			y_qty.Name = "y_qty";
-			y_qty.SetInt(0);
+		if (l.traded == 0) {
 
-			avg.Name = "avg";
-			avg.SetFloat(0.0);
+			s.touched.push_back(p);
 
-			return;
+			l.traded_at = now;
 
 		}
 
-	const char * 	x_sym_val 	= x_sym.GetString();
-	const char * 	y_sym_val	= y_sym.GetString();
-	int 			x_qty_val	= x_qty.GetInt();
-	int				y_qty_val 	= y_qty.GetInt();
-	float 			avg_val 	= avg.GetFloat();
+		l.traded += t.volume;
 
-	if (
-		std::strcmp(x_sym_val, "")	== 0 	||
-		std::strcmp(y_sym_val, "")	== 0 	||
-		x_qty_val 					== 0 	||
-		y_qty_val					== 0	||
-		avg_val 					== 0.0
-	)
+	}
 
-		// study not initialized
+	// depth changes at traded prices. after a resync the changes are
+	// incomplete, so the waiting trades are dropped.
 
-		return;
+	if (state->depth.resync) {
 
-	
-	s_MarketDepthEntry de;
+		for (int side = 0; side < 2; side++) {
 
-	float bid 		= 0;
-	float ask 		= 0;
-	float y_mid 	= 0;
-	float offset	= 0;
-	float x_bid 	= 0;
-	float x_ask 	= 0;
-	float y_bid 	= 0;
-	float y_ask 	= 0;
+			iceberg_side & s = sides[side];
 
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(x_sym_val, de, 0);
+			for (size_t i = 0; i < s.touched.size(); i++)
 
-	x_bid = de.AdjustedPrice;
+				s.levels.at(s.touched[i]).traded = 0;
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(x_sym_val, de, 0);
+			s.touched.clear();
 
-	x_ask = de.AdjustedPrice;
-	
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(y_sym_val, de, 0);
+		}
 
-	y_bid = de.AdjustedPrice;
+		changed = 0;
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(y_sym_val, de, 0);
+	}
 
-	y_ask = de.AdjustedPrice;
+	for (int i = 0; i < changed; i++) {
 
-	// spread is y - x
+		const depth_change &	c		= changes[i];
+		const int				side	= c.side;
+		const int				p		= c.price;
+		iceberg_side &			s		= sides[side];
 
-	bid = x_bid * x_qty_val + y_ask * y_qty_val;
-	ask = x_ask * x_qty_val + y_bid * y_qty_val;
+		if (c.out_of_view || !s.levels.contains(p))
 
-	y_mid 	= (y_bid + y_ask) / 2;
-	offset	= (bid + ask) / 2 - avg_val;
+			continue;
 
-	sc.Subgraph[0].Arrays[0][sc.Index]	= y_mid;
-	sc.Subgraph[0].Data[sc.Index]		= offset;
+		iceberg_level & l = s.levels.at(p);
 
-}
+		if (l.traded == 0)
 
+			continue;
 
-/*
+		const int expected	= c.old_qty > l.traded ? c.old_qty - l.traded : 0;
+		const int refill	= c.new_qty - expected;
 
-INCOMPLETE
+		l.traded = 0;
 
-SCSFExport scsf_large_orders(SCStudyInterfaceRef sc) {
+		if (refill <= 0 || c.new_qty == 0)
 
-	/*
+			continue;
 
-	#define bid_lvls_col	0
-	#define bid_qtys_col   	1
-	#define bid_tics_col    2
-	#define ask_lvls_col 	3
-	#define ask_qtys_col   	4
-	#define ask_tics_col	5
+		if (s.refill(p, refill, now, min_refills, expiry) && log_input.GetYesNo()) {
 
-	// START	large order levels, liquidity balance, from high/low
+			SCString fmt;
 
-	if (threshold <= 0 || max_outputs <= 0)
+			sc.AddMessageToLog(
+				fmt.Format(
+					"icebergs %s %s %.4f refills: %d hidden: %d",
+					sc.Symbol.GetChars(),
+					side == DEPTH_BID ? "bid" : "ask",
+					scale.price(p),
+					l.refills,
+					l.hidden
+				),
+				0
+			);
 
-		// user has not properly initialized the study
+		}
 
-		return;
+	}
 
-	// record bids and asks where qty > threshold.
-	// also find distance from high and low if
-	// reasonably close.
+	for (int side = 0; side < 2; side++) {
 
-	float	bid_lvls[max_outputs];
-	float	bid_qtys[max_outputs];
-	int   	bid_tics[max_outputs];
-	float 	ask_lvls[max_outputs];
-	float 	ask_qtys[max_outputs];
-	int		ask_tics[max_outputs];
+		sides[side].expire_trades(now);
+		sides[side].expire(now, expiry);
 
-	int len_bids = 0;
-	int len_asks = 0;
+	}
 
-	int from_high 	= -1;
-	int from_low 	= -1;
+	// largest flagged price on each side
 
-	int 	total_bids 			= 0;
-	int 	total_asks 			= 0;
-	float	liquidity_balance 	= -1.0;
+	for (int side = 0; side < 2; side++) {
 
-	int max_levels = sc.GetMaximumMarketDepthLevels();
-	
-	if (max_levels > sc.ArraySize)
-		
-		max_levels = sc.ArraySize;
+		const iceberg_side &	s		= sides[side];
+		const int				base	= side * 4;
+		int						best	= -1;
+		int						hidden	= 0;
 
-	int max_bid_levels = min(max_levels, sc.GetBidMarketDepthNumberOfLevels());
-	int max_ask_levels = min(max_levels, sc.GetAskMarketDepthNumberOfLevels());
+		for (int i = 0; i < s.num_flagged; i++) {
 
-	s_MarketDepthEntry e;
+			const iceberg_level & l = s.levels.values[s.flagged[i] - s.levels.anchor];
 
-	for (int i = 0; i < max_bid_levels; i++) {
+			if (l.hidden > hidden) {
 
-		sc.GetBidMarketDepthEntryAtLevel(e, i);
+				best	= i;
+				hidden	= l.hidden;
 
-		if (e.Quantity > threshold) {
+			}
 
-			bid_lvls[len_bids] = e.AdjustedPrice;
-			bid_qtys[len_bids] = static_cast<float>(e.Quantity);
-			bid_tics[len_bids] = i;
+		}
 
-			len_bids++;
+		if (best < 0) {
 
-		}
+			// nothing flagged
 
-		if (i < num_liq_levels)
+			for (int k = 0; k < 4; k++)
 
-			total_bids += e.Quantity;
+				sc.Subgraph[base + k][sc.Index] = 0;
 
-		if (e.AdjustedPrice == sc.DailyLow)
+			continue;
 
-			from_low = i;
+		}
 
-		if (len_bids >= max_outputs) 
-		
-			break;
+		const int				p		= s.flagged[best];
+		const iceberg_level &	l		= s.levels.values[p - s.levels.anchor];
+		const double		minutes	= (l.last - l.first) * 24 * 60;
+
+		sc.Subgraph[base][sc.Index]		= scale.price(p);
+		sc.Subgraph[base + 1][sc.Index]	= static_cast<float>(l.hidden);
+		sc.Subgraph[base + 2][sc.Index]	= static_cast<float>(l.refills);
+		sc.Subgraph[base + 3][sc.Index]	= static_cast<float>(l.refills / (minutes > 1 ? minutes : 1));
 
 	}
 
-	for (int i = 0; i < max_ask_levels; i++) {
+}
 
-		sc.GetAskMarketDepthEntryAtLevel(e, i);
 
-		if (e.Quantity > threshold) {
 
-			ask_lvls[len_asks] = e.AdjustedPrice;
-			ask_qtys[len_asks] = static_cast<float>(e.Quantity);
-			ask_tics[len_asks] = i;
+// cross-contract ranges for bond rngs. for every pair (b, j) of contracts,
+// tracks the lowest bid and highest ask seen for contract j at each bid and
+// ask price of contract b. each update reads the top of book of every
+// contract once and updates all n x n pairs from that snapshot. the values at
+// the current base prices are left in lo_bid / hi_ask for the dom overlay.
+// ladders are keyed in ticks of key_tick; the extremes they hold are in each
+// contract's own ticks, so they convert back exactly.
 
-			len_asks++;
+#define MAX_CONTRACTS 16
 
-		}
+struct cross_range_matrix {
 
-		if (e.AdjustedPrice == sc.DailyHigh)
+	int							n			= 0;
+	tick_scale					key;				// ladder keys, ticks of key_tick
+	tick_scale					scales[MAX_CONTRACTS];	// each contract's own, 0 until known
+	std::vector<std::string>	symbols;
+	std::vector<SCString>		sc_symbols;			// the same, as passed to the api
 
-			from_high = i;
+	// ladders[b * n + j], keyed by contract b's bid (lo_bids) or ask (hi_asks)
 
-		if (i < num_liq_levels)
+	std::vector<price_ladder<int>>	lo_bids;
+	std::vector<price_ladder<int>>	hi_asks;
 
-			total_asks += e.Quantity;
+	int		bid[MAX_CONTRACTS];					// own ticks, 0 when the contract has no book
+	int		ask[MAX_CONTRACTS];
+	int		bid_key[MAX_CONTRACTS];				// the same in ticks of key_tick
+	int		ask_key[MAX_CONTRACTS];
+	int		lo_bid[MAX_CONTRACTS][MAX_CONTRACTS];	// contract j's ticks, INT_MAX / INT_MIN until seen
+	int		hi_ask[MAX_CONTRACTS][MAX_CONTRACTS];
 
-		if (len_asks >= max_outputs)
+	void reset(const std::vector<std::string> & symbols_, const float key_tick) {
 
-			break;
+		symbols		= symbols_;
+		n			= static_cast<int>(symbols.size());
+		key			= tick_scale(key_tick, 1);
 
-	}
+		sc_symbols.clear();
+
+		for (int i = 0; i < n; i++) {
+
+			sc_symbols.emplace_back(symbols[i].c_str());
 
-	liquidity_balance = static_cast<float>(total_asks) / total_bids;
+			scales[i] = tick_scale(0, 1);
 
-	// END		large order levels, liquidity balance, from high/low
+		}
 
-	// START	spreadsheet
+		lo_bids.assign(n * n, price_ladder<int>());
+		hi_asks.assign(n * n, price_ladder<int>());
 
-	// clear spreadsheet
+		for (int i = 0; i < n * n; i++) {
 
-	const int 	lo = base_row + 1;
-	int			hi = base_row + max_outputs;
-	SCString clr = "x";
+			lo_bids[i].reset(INT_MAX);
+			hi_asks[i].reset(INT_MIN);
 
-	for (int i = lo; i < hi; i++) {
+			lo_bid[i / n][i % n] = INT_MAX;
+			hi_ask[i / n][i % n] = INT_MIN;
 
-		sc.SetSheetCellAsString(h, bid_lvls_col, i, clr);
-		sc.SetSheetCellAsString(h, bid_qtys_col, i, clr);
-		sc.SetSheetCellAsString(h, bid_tics_col, i, clr);
+		}
 
 	}
 
-	for (int i = lo; i < hi; i++) {
+	// prices for output, 0 until seen
 
-		sc.SetSheetCellAsString(h, ask_lvls_col, i, clr);
-		sc.SetSheetCellAsString(h, ask_qtys_col, i, clr);
-		sc.SetSheetCellAsString(h, ask_tics_col, i, clr);
+	float lo_bid_price(const int b, const int j) const { return lo_bid[b][j] != INT_MAX ? scales[j].price(lo_bid[b][j]) : 0; }
 
-	}
+	float hi_ask_price(const int b, const int j) const { return hi_ask[b][j] != INT_MIN ? scales[j].price(hi_ask[b][j]) : 0; }
 
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + from_high_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + from_low_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + liquidity_balance_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + net_ticks_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + imbalance_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + ask_tick_avg_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + bid_tick_avg_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + range_density_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + range_row, clr);
-	sc.SetSheetCellAsString(h, stat_val_col, base_row + sample_row, clr);
-	
-	// put all bids and asks where qty > threshold into spreadsheet
+	void update(SCStudyInterfaceRef sc) {
 
-	SCString fmt;
+		s_MarketDepthEntry de;
 
-	hi = base_row + len_bids;
-	int j = 0;
+		// one snapshot of every contract
 
-	for (int i = lo; i < hi; i++) {
+		for (int i = 0; i < n; i++) {
 
-		sc.SetSheetCellAsDouble(h, bid_lvls_col, i, bid_lvls[j]);
-		sc.SetSheetCellAsDouble(h, bid_qtys_col, i, bid_qtys[j]);
-		sc.SetSheetCellAsDouble(h, bid_tics_col, i, bid_tics[j++]);
+			if (scales[i].tick_size <= 0)
 
-	}
+				scales[i] = tick_scale(symbol_tick_size(sc, sc_symbols[i]), 1);
 
-	hi = base_row + len_asks;
-	j = 0;
+			if (scales[i].tick_size <= 0) {
 
-	for (int i = lo; i < hi; i++) {
+				// tick size not known yet, treated as no book
 
-		sc.SetSheetCellAsDouble(h, ask_lvls_col, i, ask_lvls[j]);
-		sc.SetSheetCellAsDouble(h, ask_qtys_col, i, ask_qtys[j]);
-		sc.SetSheetCellAsDouble(h, ask_tics_col, i, ask_tics[j++]);
+				bid[i] = 0;
+				ask[i] = 0;
 
-	}
+				continue;
 
-}
+			}
 
-*/
+			sc.GetBidMarketDepthEntryAtLevelForSymbol(sc_symbols[i], de, 0);
 
+			bid[i]		= scales[i].adjusted_ticks(de.AdjustedPrice);
+			bid_key[i]	= key.adjusted_ticks(de.AdjustedPrice);
 
-// for bond rngs (INCOMPLETE)
+			sc.GetAskMarketDepthEntryAtLevelForSymbol(sc_symbols[i], de, 0);
 
-void bond_rngs_set_rng(
-	const SCStudyInterfaceRef & 		sc,
-	const SCString & 					sym,
-	const float & 						base_bid,
-	const float &						base_ask,
-	s_MarketDepthEntry & 				de, 
-	std::map<float, float> * const 		bid_map,
-	std::map<float, float> * const		ask_map
-) {
+			ask[i]		= scales[i].adjusted_ticks(de.AdjustedPrice);
+			ask_key[i]	= key.adjusted_ticks(de.AdjustedPrice);
 
-	// bid
+		}
 
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(sym, de, 0);
+		call_counts.levels += 2 * n;
 
-	const float bid = de.AdjustedPrice;
+		for (int b = 0; b < n; b++) {
 
-	if (bid_map->find(base_bid) == bid_map->end())
+			if (bid[b] == 0 || ask[b] == 0)
 
-		bid_map->insert({ base_bid, DBL_MAX });
+				// no book for the base contract yet
 
-	float & lo_bid = bid_map->find(base_bid)->second;
+				continue;
 
-	if (bid < lo_bid)
+			for (int j = 0; j < n; j++) {
 
-		lo_bid = bid;
+				int & lo = lo_bids[b * n + j].at(bid_key[b]);
+				int & hi = hi_asks[b * n + j].at(ask_key[b]);
 
+				if (bid[j] != 0 && bid[j] < lo)
 
-	// ask
+					lo = bid[j];
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(sym, de, 0);
+				if (ask[j] != 0 && ask[j] > hi)
 
-	const float ask = de.AdjustedPrice;
+					hi = ask[j];
 
-	if (ask_map->find(base_ask) == ask_map->end())
+				lo_bid[b][j] = lo;
+				hi_ask[b][j] = hi;
 
-		ask_map->insert({ base_ask, INT_MIN });
+			}
 
-	float & hi_ask = ask_map->find(base_ask)->second;
+		}
 
-	if (ask > hi_ask)
+	}
 
-		hi_ask = ask;
+};
 
-}
 
+// for each contract, the low bid and high ask observed while the base contract was at its current bid and ask.
+// contracts: comma separated symbols. when empty, ZB, ZN, ZF and ZT for month_year are used.
+// base_symbol: the contract the ranges are keyed on; a root (ZN, ZF, ...) combined with month_year, or a full symbol.
+// key_tick: price resolution of the base keys; defaults to the chart's tick size.
+// subgraphs lo_bid_j / hi_ask_j can be displayed on the DOM with name and value labels.
 
 SCSFExport scsf_bond_rngs(SCStudyInterfaceRef sc) {
 
+	study_timer timer(sc, "bond_rngs");
+
 	SCInputRef debug_sheet_input	= sc.Input[0];
 	SCInputRef base_symbol_input	= sc.Input[1];	// ZN, ZF, etc...
 	SCInputRef month_year_input		= sc.Input[2];	// MYY
+	SCInputRef contracts_input		= sc.Input[3];
+	SCInputRef key_tick_input		= sc.Input[4];
 
 	if (sc.SetDefaults) {
 
 		sc.GraphName 			= "bond_rngs";
+		sc.GraphRegion 			= 0;
 		sc.AutoLoop 			= 0;
 		sc.UsesMarketDepthData 	= 1;
-		sc.HideStudy 			= 1;
+
+		SCString fmt;
+
+		for (int j = 0; j < MAX_CONTRACTS; j++) {
+
+			sc.Subgraph[2 * j].Name 			= fmt.Format("lo_bid_%d", j);
+			sc.Subgraph[2 * j].DrawStyle		= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+			sc.Subgraph[2 * j].LineLabel		= LL_DISPLAY_NAME | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_VALUE;
+
+			sc.Subgraph[2 * j + 1].Name 		= fmt.Format("hi_ask_%d", j);
+			sc.Subgraph[2 * j + 1].DrawStyle	= DRAWSTYLE_SUBGRAPH_NAME_AND_VALUE_LABELS_ONLY;
+			sc.Subgraph[2 * j + 1].LineLabel	= LL_DISPLAY_NAME | LL_VALUE_ALIGN_VALUES_SCALE | LL_DISPLAY_VALUE;
+
+		}
 
 		debug_sheet_input.Name = "debug_sheet";
 		debug_sheet_input.SetString("");
@@ -1382,192 +4964,440 @@ SCSFExport scsf_bond_rngs(SCStudyInterfaceRef sc) {
 		month_year_input.Name = "month_year";
 		month_year_input.SetString("");
 
+		contracts_input.Name = "contracts";
+		contracts_input.SetString("");
+
+		key_tick_input.Name = "key_tick";
+		key_tick_input.SetFloat(0.0);
+
 		return;
 		
 	}
 
-	SCString 		fmt;
+	struct bond_rngs_state {
+
+		cross_range_matrix	matrix;
+		std::string			contracts;		// inputs the matrix was built from
+		std::string			month_year;
+		std::string			base_symbol;
+		float				key_tick	= 0;
+		int					base		= -1;	// matrix row of the base contract
+
+	};
+
+	bond_rngs_state * state = get_state<bond_rngs_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
 
 	const char * 	debug_sheet			= debug_sheet_input.GetString();
 	const char * 	month_year			= month_year_input.GetString();
-	SCString 		base_symbol			= fmt.Format("%s%s_FUT_CME", base_symbol_input.GetString(), month_year);
-	SCString 		clr					= "";
+	const char *	contracts			= contracts_input.GetString();
+	const char *	base_symbol			= base_symbol_input.GetString();
+	const float		key_tick			= key_tick_input.GetFloat() > 0 ? key_tick_input.GetFloat() : sc.TickSize;
 
-	// sc.AddMessageToLog(base_symbol.GetChars(), 1);
 	// sc.AddMessageToLog(month_year, 1);
 
+	cross_range_matrix & m = state->matrix;
+
 	if (
-		clr.Compare(base_symbol) 		== 0 ||
-		std::strcmp(month_year, "")  	== 0
-	)
+		state->contracts.compare(contracts)		!= 0 ||
+		state->month_year.compare(month_year)	!= 0 ||
+		state->base_symbol.compare(base_symbol)	!= 0 ||
+		state->key_tick							!= key_tick
+	) {
 
-		// base symbol should be one of ZB, ZN, ZT, or ZF
-		// month year is like U22
+		// inputs changed, rebuild the contract list
 
-		return;
+		SCString					fmt;
+		std::vector<std::string>	symbols;
 
-	std::map<float, float> * zb_bids = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(0));
-	std::map<float, float> * zb_asks = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(1));
-	std::map<float, float> * zn_bids = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(2));
-	std::map<float, float> * zn_asks = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(3));
-	std::map<float, float> * zf_bids = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(4));
-	std::map<float, float> * zf_asks = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(5));
-	std::map<float, float> * zt_bids = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(6));
-	std::map<float, float> * zt_asks = reinterpret_cast<std::map<float, float>*>(sc.GetPersistentPointer(7));
+		if (std::strcmp(contracts, "") != 0) {
 
-	if (sc.LastCallToFunction) {
+			for (const char * c = contracts; *c != 0 && symbols.size() < MAX_CONTRACTS;) {
+
+				const char *	e = c + std::strcspn(c, ",");
+				const char *	b = c;
+				const char *	t = e;
+
+				// trim, "ZBH5_FUT_CME, ZNH5_FUT_CME" is two contracts
+
+				while (b < t && *b == ' ')
+
+					b++;
+
+				while (t > b && *(t - 1) == ' ')
 
-		if (zb_bids != NULL) {
+					t--;
 
-			delete zb_bids;
-			delete zb_asks;
-			delete zn_bids;
-			delete zn_asks;
-			delete zf_bids;
-			delete zf_asks;
-			delete zt_bids;
-			delete zt_asks;
+				if (t > b)
 
-			sc.SetPersistentPointer(0, NULL);
+					symbols.emplace_back(b, t - b);
+
+				c = *e == 0 ? e : e + 1;
+
+			}
+
+		} else if (std::strcmp(month_year, "") != 0) {
+
+			// month year is like U22
+
+			symbols.push_back(fmt.Format("ZB%s_FUT_CME", month_year).GetChars());
+			symbols.push_back(fmt.Format("ZN%s_FUT_CME", month_year).GetChars());
+			symbols.push_back(fmt.Format("ZF%s_FUT_CME", month_year).GetChars());
+			symbols.push_back(fmt.Format("ZT%s_FUT_CME", month_year).GetChars());
 
 		}
 
-		return;
+		// base symbol is a root combined with month_year, or a full symbol
 
-	}
+		std::string base_full = fmt.Format("%s%s_FUT_CME", base_symbol, month_year).GetChars();
 
-	if (zb_bids == NULL) {
+		state->base = -1;
 
-		zb_bids = new std::map<float, float>();
-		zb_asks = new std::map<float, float>();
-		zn_bids = new std::map<float, float>();
-		zn_asks = new std::map<float, float>();
-		zf_bids = new std::map<float, float>();
-		zf_asks = new std::map<float, float>();
-		zt_bids = new std::map<float, float>();
-		zt_asks = new std::map<float, float>();
+		for (int i = 0; i < static_cast<int>(symbols.size()); i++)
+
+			if (symbols[i] == base_symbol || symbols[i] == base_full)
+
+				state->base = i;
+
+		if (state->key_tick != key_tick || m.symbols != symbols)
+
+			// a new base symbol alone keeps the ranges seen so far
+
+			m.reset(symbols, key_tick);
+
+		state->contracts	= contracts;
+		state->month_year	= month_year;
+		state->base_symbol	= base_symbol;
+		state->key_tick		= key_tick;
 
 	}
 
-	SCString zb_sym = fmt.Format("ZB%s_FUT_CME", month_year);
-	SCString zn_sym = fmt.Format("ZN%s_FUT_CME", month_year);
-	SCString zf_sym = fmt.Format("ZF%s_FUT_CME", month_year);
-	SCString zt_sym = fmt.Format("ZT%s_FUT_CME", month_year);
+	const int base = state->base;
 
-	if (
-		base_symbol.Compare(zb_sym) != 0 &&
-		base_symbol.Compare(zn_sym) != 0 &&
-		base_symbol.Compare(zf_sym) != 0 &&
-		base_symbol.Compare(zt_sym) != 0
-	)
+	if (base < 0)
 
 		// not properly initialized
-		// base symbol input should be "ZB", "ZN", "ZF", or "ZT"
+		// base symbol input should be one of the contracts, e.g. "ZB", "ZN", "ZF", or "ZT"
 
 		return;
 
-	s_MarketDepthEntry de;
+	m.update(sc);
 
-	sc.GetBidMarketDepthEntryAtLevelForSymbol(base_symbol, de, 0);
-	const float base_bid = de.AdjustedPrice;
+	for (int j = 0; j < m.n; j++) {
 
-	sc.GetAskMarketDepthEntryAtLevelForSymbol(base_symbol, de, 0);
-	const float base_ask = de.AdjustedPrice;
+		sc.Subgraph[2 * j][sc.Index]		= m.lo_bid_price(base, j);
+		sc.Subgraph[2 * j + 1][sc.Index]	= m.hi_ask_price(base, j);
 
-	bond_rngs_set_rng(sc, zb_sym, base_bid, base_ask, de, zb_bids, zb_asks);
-	bond_rngs_set_rng(sc, zn_sym, base_bid, base_ask, de, zn_bids, zn_asks);
-	bond_rngs_set_rng(sc, zf_sym, base_bid, base_ask, de, zf_bids, zf_asks);
-	bond_rngs_set_rng(sc, zt_sym, base_bid, base_ask, de, zt_bids, zt_asks);
+	}
 
 	// debug
-	
-	void * h = sc.GetSpreadsheetSheetHandleByName(debug_sheet, "Sheet1", false);
 
-	for (int i = 1; i < 5; i++) {
+	if (std::strcmp(debug_sheet, "") == 0)
+
+		return;
 	
-		sc.SetSheetCellAsString(h, i, 1, clr);
-		sc.SetSheetCellAsString(h, i, 2, clr);
+	void * 			h = sc.GetSpreadsheetSheetHandleByName(debug_sheet, "Sheet1", false);
+	sheet_writer	w(sc, h);
+
+	w.set(0, 0, m.symbols[base].c_str());
+
+	for (int j = 0; j < m.n; j++) {
+
+		w.set(j + 1, 1, m.lo_bid_price(base, j));
+		w.set(j + 1, 2, m.hi_ask_price(base, j));
+
+	}
+
+	w.flush();
+
+}
+
+
+// rows of the tpo sheet, one per s_StudyProfileInformation member
+
+#define NUM_MEMBERS 51
+
+#define	StartDateTime_row						0
+#define NumberOfTrades_row						1
+#define Volume_row								2
+#define BidVolume_row							3
+#define AskVolume_row							4
+#define TotalTPOCount_row						5
+#define OpenPrice_row							6
+#define HighestPrice_row						7
+#define LowestPrice_row							8
+#define LastPrice_row							9
+#define TPOMidpointPrice_row					10
+#define TPOMean_row								11
+#define TPOStdDev_row							12
+#define TPOErrorOfMean_row						13
+#define TPOPOCPrice_row							14
+#define TPOValueAreaHigh_row					15
+#define TPOValueAreaLow_row						16
+#define TPOCountAbovePOC_row					17
+#define TPOCountBelowPOC_row					18
+#define VolumeMidpointPrice_row					19
+#define VolumePOCPrice_row						20
+#define VolumeValueAreaHigh_row					21
+#define VolumeValueAreaLow						22
+#define VolumeAbovePOC_row						23
+#define VolumeBelowPOC_row						24
+#define POCAboveBelowVolumeImbalancePercent_row	25
+#define VolumeAboveLastPrice_row				26
+#define VolumeBelowLastPrice_row				27
+#define BidVolumeAbovePOC_row					28
+#define BidVolumeBelowPOC_row					29
+#define AskVolumeAbovePOC_row					30
+#define AskVolumeBelowPOC_row					31
+#define VolumeTimesPriceInTicks_row				32
+#define TradesTimesPriceInTicks_row				33
+#define TradesTimesPriceSquaredInTicks_row		34
+#define IBRHighPrice_row						35
+#define IBRLowPrice_row							36
+#define OpeningRangeHighPrice_row				37
+#define OpeningRangeLowPrice_row				38
+#define VolumeWeightedAveragePrice_row			39
+#define MaxTPOBlocksCount_row					40
+#define TPOCountMaxDigits_row					41
+#define DisplayIndependentColumns_row			42
+#define EveningSession_row						43
+#define AverageSubPeriodRange_row				44
+#define RotationFactor_row						45
+#define VolumeAboveTPOPOC_row					46
+#define VolumeBelowTPOPOC_row					47
+#define EndDateTime_row							48
+#define BeginIndex_row							49
+#define EndIndex_row							50
+
+
+// writes one profile to column col of the tpo sheet
+
+void tpo_write_profile(sheet_writer & w, const int col, const n_ACSIL::s_StudyProfileInformation & p) {
+
+	// sc.SetSheetCellAsString(h, col, StartDateTime_row, p.m_StartDateTime);
+	w.set(col, NumberOfTrades_row, p.m_NumberOfTrades);
+	w.set(col, Volume_row, p.m_Volume);
+	w.set(col, BidVolume_row, p.m_BidVolume);
+	w.set(col, AskVolume_row, p.m_AskVolume);
+	w.set(col, TotalTPOCount_row, p.m_TotalTPOCount);
+	w.set(col, OpenPrice_row, p.m_OpenPrice);
+	w.set(col, HighestPrice_row, p.m_HighestPrice);
+	w.set(col, LowestPrice_row, p.m_LowestPrice);
+	w.set(col, LastPrice_row, p.m_LastPrice);
+	w.set(col, TPOMidpointPrice_row, p.m_TPOMidpointPrice);
+	w.set(col, TPOMean_row, p.m_TPOMean);
+	w.set(col, TPOStdDev_row, p.m_TPOStdDev);
+	w.set(col, TPOErrorOfMean_row, p.m_TPOErrorOfMean);
+	w.set(col, TPOMean_row, p.m_TPOMean);
+	w.set(col, TPOPOCPrice_row, p.m_TPOPOCPrice);
+	w.set(col, TPOValueAreaHigh_row, p.m_TPOValueAreaHigh);
+	w.set(col, TPOValueAreaLow_row, p.m_TPOValueAreaLow);
+	w.set(col, TPOCountAbovePOC_row, p.m_TPOCountAbovePOC);
+	w.set(col, TPOCountBelowPOC_row, p.m_TPOCountBelowPOC);
+	w.set(col, VolumeMidpointPrice_row, p.m_VolumeMidpointPrice);
+	w.set(col, VolumePOCPrice_row, p.m_VolumePOCPrice);
+	w.set(col, VolumeValueAreaHigh_row, p.m_VolumeValueAreaHigh);
+	w.set(col, VolumeValueAreaLow, p.m_VolumeValueAreaLow);
+	w.set(col, VolumeAbovePOC_row, p.m_VolumeAbovePOC);
+	w.set(col, VolumeBelowPOC_row, p.m_VolumeBelowPOC);
+	w.set(col, POCAboveBelowVolumeImbalancePercent_row, p.m_POCAboveBelowVolumeImbalancePercent);
+	w.set(col, VolumeAboveLastPrice_row, p.m_VolumeAboveLastPrice);
+	w.set(col, VolumeBelowLastPrice_row, p.m_VolumeBelowLastPrice);
+	w.set(col, BidVolumeAbovePOC_row, p.m_BidVolumeAbovePOC);
+	w.set(col, BidVolumeBelowPOC_row, p.m_BidVolumeBelowPOC);
+	w.set(col, AskVolumeAbovePOC_row, p.m_AskVolumeAbovePOC);
+	w.set(col, AskVolumeBelowPOC_row, p.m_AskVolumeBelowPOC);
+	w.set(col, VolumeTimesPriceInTicks_row, p.m_VolumeTimesPriceInTicks);
+	w.set(col, TradesTimesPriceInTicks_row, p.m_TradesTimesPriceInTicks);
+	w.set(col, TradesTimesPriceSquaredInTicks_row, p.m_TradesTimesPriceSquaredInTicks);
+	w.set(col, IBRHighPrice_row, p.m_IBRHighPrice);
+	w.set(col, IBRLowPrice_row, p.m_IBRLowPrice);
+	w.set(col, OpeningRangeHighPrice_row, p.m_OpeningRangeHighPrice);
+	w.set(col, OpeningRangeLowPrice_row, p.m_OpeningRangeLowPrice);
+	w.set(col, VolumeWeightedAveragePrice_row, p.m_VolumeWeightedAveragePrice);
+	w.set(col, MaxTPOBlocksCount_row, p.m_MaxTPOBlocksCount);
+	w.set(col, TPOCountMaxDigits_row, p.m_TPOCountMaxDigits);
+	// sc.SetSheetCellAsDouble(h, col, DisplayIndependentColumns_row, p.m_DisplayIndependentColumns);
+	w.set(col, EveningSession_row, p.m_EveningSession);
+	w.set(col, AverageSubPeriodRange_row, p.m_AverageSubPeriodRange);
+	w.set(col, RotationFactor_row, p.m_RotationFactor);
+	w.set(col, VolumeAboveTPOPOC_row, p.m_VolumeAboveTPOPOC);
+	w.set(col, VolumeBelowTPOPOC_row, p.m_VolumeBelowTPOPOC);
+	// sc.SetSheetCellAsString(h, col, EndDateTime_row, p.m_EndDateTime);
+	w.set(col, BeginIndex_row, p.m_BeginIndex);
+	w.set(col, EndIndex_row, p.m_EndIndex);
+
+}
+
+
+// binary export of completed profiles: a 64 byte header followed by fixed
+// width records of NUM_MEMBERS float64 values, little endian, in the order of
+// the rows above. date times are sc date times (days since 1899-12-30). from
+// python:
+//
+//		np.memmap(path, dtype = "<f8", mode = "r", offset = 64).reshape(-1, 51)
+
+#define TPO_FILE_MAGIC	"tpoprof1"
+
+struct tpo_file_header {
+
+	char	magic[8];
+	int		version			= 1;
+	int		header_bytes	= 64;
+	int		columns			= NUM_MEMBERS;
+	int		record_bytes	= NUM_MEMBERS * sizeof(double);
+	char	pad[40]			= {};
+
+};
+
+static_assert(sizeof(tpo_file_header) == 64, "tpo_file_header must be 64 bytes");
+
+
+void tpo_record(const n_ACSIL::s_StudyProfileInformation & p, double * r) {
+
+	r[StartDateTime_row]						= p.m_StartDateTime.GetAsDouble();
+	r[NumberOfTrades_row]						= p.m_NumberOfTrades;
+	r[Volume_row]								= p.m_Volume;
+	r[BidVolume_row]							= p.m_BidVolume;
+	r[AskVolume_row]							= p.m_AskVolume;
+	r[TotalTPOCount_row]						= p.m_TotalTPOCount;
+	r[OpenPrice_row]							= p.m_OpenPrice;
+	r[HighestPrice_row]							= p.m_HighestPrice;
+	r[LowestPrice_row]							= p.m_LowestPrice;
+	r[LastPrice_row]							= p.m_LastPrice;
+	r[TPOMidpointPrice_row]						= p.m_TPOMidpointPrice;
+	r[TPOMean_row]								= p.m_TPOMean;
+	r[TPOStdDev_row]							= p.m_TPOStdDev;
+	r[TPOErrorOfMean_row]						= p.m_TPOErrorOfMean;
+	r[TPOPOCPrice_row]							= p.m_TPOPOCPrice;
+	r[TPOValueAreaHigh_row]						= p.m_TPOValueAreaHigh;
+	r[TPOValueAreaLow_row]						= p.m_TPOValueAreaLow;
+	r[TPOCountAbovePOC_row]						= p.m_TPOCountAbovePOC;
+	r[TPOCountBelowPOC_row]						= p.m_TPOCountBelowPOC;
+	r[VolumeMidpointPrice_row]					= p.m_VolumeMidpointPrice;
+	r[VolumePOCPrice_row]						= p.m_VolumePOCPrice;
+	r[VolumeValueAreaHigh_row]					= p.m_VolumeValueAreaHigh;
+	r[VolumeValueAreaLow]						= p.m_VolumeValueAreaLow;
+	r[VolumeAbovePOC_row]						= p.m_VolumeAbovePOC;
+	r[VolumeBelowPOC_row]						= p.m_VolumeBelowPOC;
+	r[POCAboveBelowVolumeImbalancePercent_row]	= p.m_POCAboveBelowVolumeImbalancePercent;
+	r[VolumeAboveLastPrice_row]					= p.m_VolumeAboveLastPrice;
+	r[VolumeBelowLastPrice_row]					= p.m_VolumeBelowLastPrice;
+	r[BidVolumeAbovePOC_row]					= p.m_BidVolumeAbovePOC;
+	r[BidVolumeBelowPOC_row]					= p.m_BidVolumeBelowPOC;
+	r[AskVolumeAbovePOC_row]					= p.m_AskVolumeAbovePOC;
+	r[AskVolumeBelowPOC_row]					= p.m_AskVolumeBelowPOC;
+	r[VolumeTimesPriceInTicks_row]				= p.m_VolumeTimesPriceInTicks;
+	r[TradesTimesPriceInTicks_row]				= p.m_TradesTimesPriceInTicks;
+	r[TradesTimesPriceSquaredInTicks_row]		= p.m_TradesTimesPriceSquaredInTicks;
+	r[IBRHighPrice_row]							= p.m_IBRHighPrice;
+	r[IBRLowPrice_row]							= p.m_IBRLowPrice;
+	r[OpeningRangeHighPrice_row]				= p.m_OpeningRangeHighPrice;
+	r[OpeningRangeLowPrice_row]					= p.m_OpeningRangeLowPrice;
+	r[VolumeWeightedAveragePrice_row]			= p.m_VolumeWeightedAveragePrice;
+	r[MaxTPOBlocksCount_row]					= p.m_MaxTPOBlocksCount;
+	r[TPOCountMaxDigits_row]					= p.m_TPOCountMaxDigits;
+	r[DisplayIndependentColumns_row]			= p.m_DisplayIndependentColumns;
+	r[EveningSession_row]						= p.m_EveningSession;
+	r[AverageSubPeriodRange_row]				= p.m_AverageSubPeriodRange;
+	r[RotationFactor_row]						= p.m_RotationFactor;
+	r[VolumeAboveTPOPOC_row]					= p.m_VolumeAboveTPOPOC;
+	r[VolumeBelowTPOPOC_row]					= p.m_VolumeBelowTPOPOC;
+	r[EndDateTime_row]							= p.m_EndDateTime.GetAsDouble();
+	r[BeginIndex_row]							= p.m_BeginIndex;
+	r[EndIndex_row]								= p.m_EndIndex;
+
+}
+
+
+// appends the completed profiles (index 1 and up) that start after the
+// file's last record, oldest first. returns the number appended or -1.
+
+int tpo_export(SCStudyInterfaceRef sc, const int study_id, const int num_profiles, const char * path) {
+
+	double	last	= -1;
+	FILE *	f		= fopen(path, "rb");
+
+	if (f != NULL) {
+
+		double r[NUM_MEMBERS];
+
+		if (
+			fseek(f, -static_cast<long>(sizeof(r)), SEEK_END) == 0 &&
+			ftell(f) >= static_cast<long>(sizeof(tpo_file_header)) &&
+			fread(r, sizeof(r), 1, f) == 1
+		)
+
+			last = r[StartDateTime_row];
+
+		fclose(f);
+
+	}
+
+	f = fopen(path, "ab");
+
+	if (f == NULL)
+
+		return -1;
+
+	fseek(f, 0, SEEK_END);
+
+	if (ftell(f) == 0) {
+
+		tpo_file_header header;
+
+		std::memcpy(header.magic, TPO_FILE_MAGIC, sizeof(header.magic));
+
+		fwrite(&header, sizeof(header), 1, f);
 
 	}
 
-	sc.SetSheetCellAsString(h, 0, 0, base_symbol);
+	int		appended = 0;
+	double	r[NUM_MEMBERS];
+
+	for (int i = num_profiles - 1; i >= 1; i--) {
+
+		n_ACSIL::s_StudyProfileInformation p;
+
+		if (!sc.GetStudyProfileInformation(study_id, i, p))
+
+			continue;
+
+		tpo_record(p, r);
+
+		if (r[StartDateTime_row] <= last)
 
-	sc.SetSheetCellAsDouble(h, 1, 1, zb_bids->find(base_bid)->second);
-	sc.SetSheetCellAsDouble(h, 1, 2, zb_asks->find(base_ask)->second);
-	sc.SetSheetCellAsDouble(h, 2, 1, zn_bids->find(base_bid)->second);
-	sc.SetSheetCellAsDouble(h, 2, 2, zn_asks->find(base_ask)->second);
-	sc.SetSheetCellAsDouble(h, 3, 1, zf_bids->find(base_bid)->second);
-	sc.SetSheetCellAsDouble(h, 3, 2, zf_asks->find(base_ask)->second);
-	sc.SetSheetCellAsDouble(h, 4, 1, zt_bids->find(base_bid)->second);
-	sc.SetSheetCellAsDouble(h, 4, 2, zt_asks->find(base_ask)->second);
+			continue;
 
-	// output to dom using subgraph line label?
+		fwrite(r, sizeof(r), 1, f);
+
+		last = r[StartDateTime_row];
+
+		appended++;
+
+	}
+
+	fclose(f);
+
+	return appended;
 
 }
 
 
 SCSFExport scsf_tpo_to_spreadsheet(SCStudyInterfaceRef sc) {
 
-	#define NUM_MEMBERS 51
-
-	#define	StartDateTime_row						0
-    #define NumberOfTrades_row						1
-    #define Volume_row								2
-    #define BidVolume_row							3
-    #define AskVolume_row							4
-    #define TotalTPOCount_row						5
-    #define OpenPrice_row							6
-    #define HighestPrice_row						7
-    #define LowestPrice_row							8
-	#define LastPrice_row							9
-    #define TPOMidpointPrice_row					10
-    #define TPOMean_row								11
-    #define TPOStdDev_row							12
-    #define TPOErrorOfMean_row						13
-    #define TPOPOCPrice_row							14
-    #define TPOValueAreaHigh_row					15
-    #define TPOValueAreaLow_row						16
-    #define TPOCountAbovePOC_row					17
-    #define TPOCountBelowPOC_row					18
-    #define VolumeMidpointPrice_row					19
-    #define VolumePOCPrice_row						20
-    #define VolumeValueAreaHigh_row					21
-    #define VolumeValueAreaLow						22
-    #define VolumeAbovePOC_row						23
-    #define VolumeBelowPOC_row						24
-    #define POCAboveBelowVolumeImbalancePercent_row	25
-    #define VolumeAboveLastPrice_row				26
-    #define VolumeBelowLastPrice_row				27
-    #define BidVolumeAbovePOC_row					28
-    #define BidVolumeBelowPOC_row					29
-    #define AskVolumeAbovePOC_row					30
-    #define AskVolumeBelowPOC_row					31
-    #define VolumeTimesPriceInTicks_row				32
-	#define TradesTimesPriceInTicks_row				33
-    #define TradesTimesPriceSquaredInTicks_row		34
-    #define IBRHighPrice_row						35
-    #define IBRLowPrice_row							36
-    #define OpeningRangeHighPrice_row				37
-    #define OpeningRangeLowPrice_row				38
-    #define VolumeWeightedAveragePrice_row			39
-    #define MaxTPOBlocksCount_row					40
-    #define TPOCountMaxDigits_row					41
-    #define DisplayIndependentColumns_row			42
-    #define EveningSession_row						43
-    #define AverageSubPeriodRange_row				44
-    #define RotationFactor_row						45
-    #define VolumeAboveTPOPOC_row					46
-    #define VolumeBelowTPOPOC_row					47
-    #define EndDateTime_row							48
-    #define BeginIndex_row							49
-    #define EndIndex_row							50
+	study_timer timer(sc, "tpo_to_spreadsheet");
 
 	SCInputRef file_name_input 		= sc.Input[0];  // spreadsheet file name
 	SCInputRef sheet_name_input		= sc.Input[1];  // specific sheet
 	SCInputRef num_profiles_input	= sc.Input[2];	// max number of profiles to use
 	SCInputRef study_id_input		= sc.Input[3];  // TPO study id
-
-	int & initialized = sc.GetPersistentInt(0);
+	SCInputRef export_file_input	= sc.Input[4];	// binary file for completed profiles
 
 	if (sc.SetDefaults) {
 
@@ -1587,21 +5417,40 @@ SCSFExport scsf_tpo_to_spreadsheet(SCStudyInterfaceRef sc) {
 		study_id_input.Name = "study_id";
 		study_id_input.SetInt(-1);
 
-		initialized = 0;
+		export_file_input.Name = "export_file";
+		export_file_input.SetString("");
 
 		return;
 		
 	}
 
+	struct tpo_state {
+
+		int		initialized	= 0;
+		int		begin_index	= 0;	// first bar of the live profile
+
+	};
+
+	tpo_state * state = get_state<tpo_state>(sc, 0);
+
+	if (state == NULL)
+
+		// last call, state has been released
+
+		return;
+
 	const char * 	file_name 		= file_name_input.GetString();
 	const char * 	sheet_name		= sheet_name_input.GetString();
-	SCString		clr				= "";
+	const char *	export_file		= export_file_input.GetString();
 	int 			num_profiles 	= num_profiles_input.GetInt();
 	int				study_id		= study_id_input.GetInt();
+	const bool		to_sheet		= *file_name != 0 && *sheet_name != 0;
+	const bool		to_file			= *export_file != 0;
+	int &			initialized		= state->initialized;
+	int &			begin_index		= state->begin_index;
 
 	if (
-		!clr.Compare(file_name) 	||
-		!clr.Compare(sheet_name)	||
+		(!to_sheet && !to_file) 	||
 		num_profiles < 0			||
 		study_id     < 0
 	)
@@ -1610,143 +5459,121 @@ SCSFExport scsf_tpo_to_spreadsheet(SCStudyInterfaceRef sc) {
 
 		return;
 
-	void * h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+	if (sc.IsFullRecalculation)
+
+		initialized = 0;
+
+	// after the first run, only the live profile (index 0, column 1) is
+	// refreshed. when a new profile starts, the profiles shift one column
+	// to the right, so the closed ones are written once more.
+
+	n_ACSIL::s_StudyProfileInformation p;
+
+	if (!sc.GetStudyProfileInformation(study_id, 0, p))
+
+		return;
+
+	const bool rollover = !initialized || p.m_BeginIndex != begin_index;
+
+	begin_index = p.m_BeginIndex;
+	initialized	= 1;
+
+	if (rollover && to_file && tpo_export(sc, study_id, num_profiles, export_file) < 0)
+
+		sc.AddMessageToLog("tpo_to_spreadsheet: could not open export_file", 1);
+
+	if (!to_sheet)
+
+		return;
+
+	void * 			h = sc.GetSpreadsheetSheetHandleByName(file_name, sheet_name, false);
+	sheet_writer	w(sc, h);
 
 	// set row headers
 
-	if (!initialized) {
-
-		sc.SetSheetCellAsString(h, 0, StartDateTime_row, "StartDateTime");
-		sc.SetSheetCellAsString(h, 0, NumberOfTrades_row, "NumberOfTrades");
-		sc.SetSheetCellAsString(h, 0, Volume_row, "Volume");
-		sc.SetSheetCellAsString(h, 0, BidVolume_row, "BidVolume");
-		sc.SetSheetCellAsString(h, 0, AskVolume_row, "AskVolume");
-		sc.SetSheetCellAsString(h, 0, TotalTPOCount_row, "TotalTPOCount");
-		sc.SetSheetCellAsString(h, 0, OpenPrice_row, "OpenPrice");
-		sc.SetSheetCellAsString(h, 0, HighestPrice_row, "Highest_price");
-		sc.SetSheetCellAsString(h, 0, LowestPrice_row, "LowestPrice");
-		sc.SetSheetCellAsString(h, 0, LastPrice_row, "LastPrice");
-		sc.SetSheetCellAsString(h, 0, TPOMidpointPrice_row, "TPOMidpointPrice");
-		sc.SetSheetCellAsString(h, 0, TPOMean_row, "TPOMean");
-		sc.SetSheetCellAsString(h, 0, TPOStdDev_row, "TPOStdDev");
-		sc.SetSheetCellAsString(h, 0, TPOErrorOfMean_row, "TPOErrorOfMean");
-		sc.SetSheetCellAsString(h, 0, TPOMean_row, "TPOMean");
-		sc.SetSheetCellAsString(h, 0, TPOPOCPrice_row, "TPOPOCPrice");
-		sc.SetSheetCellAsString(h, 0, TPOValueAreaHigh_row, "TPOValueAreaHigh");
-		sc.SetSheetCellAsString(h, 0, TPOValueAreaLow_row, "TPOValueAreaLow");
-		sc.SetSheetCellAsString(h, 0, TPOCountAbovePOC_row, "TPOCountAbovePOC");
-		sc.SetSheetCellAsString(h, 0, TPOCountBelowPOC_row, "TPOCountBelowPOC");
-		sc.SetSheetCellAsString(h, 0, VolumeMidpointPrice_row, "VolumeMidpointPrice");
-		sc.SetSheetCellAsString(h, 0, VolumePOCPrice_row, "VolumePOCPrice");
-		sc.SetSheetCellAsString(h, 0, VolumeValueAreaHigh_row, "VolumeValueAreaHigh");
-		sc.SetSheetCellAsString(h, 0, VolumeValueAreaLow, "VolumeValueAreaLow");
-		sc.SetSheetCellAsString(h, 0, VolumeAbovePOC_row, "VolumeAbovePOC");
-		sc.SetSheetCellAsString(h, 0, VolumeBelowPOC_row, "VolumeBelowPOC");
-		sc.SetSheetCellAsString(h, 0, POCAboveBelowVolumeImbalancePercent_row, "POCAboveBelowVolumeImbalancePercent");
-		sc.SetSheetCellAsString(h, 0, VolumeAboveLastPrice_row, "VolumeAboveLastPrice");
-		sc.SetSheetCellAsString(h, 0, VolumeBelowLastPrice_row, "VolumeBelowLastPrice");
-		sc.SetSheetCellAsString(h, 0, BidVolumeAbovePOC_row, "BidVolumeAbovePOC");
-		sc.SetSheetCellAsString(h, 0, BidVolumeBelowPOC_row, "BidVolumeBelowPOC");
-		sc.SetSheetCellAsString(h, 0, AskVolumeAbovePOC_row, "AskVolumeAbovePOC");
-		sc.SetSheetCellAsString(h, 0, AskVolumeBelowPOC_row, "AskVolumeBelowPOC");
-		sc.SetSheetCellAsString(h, 0, VolumeTimesPriceInTicks_row, "VolumeTimesPriceInTicks");
-		sc.SetSheetCellAsString(h, 0, TradesTimesPriceInTicks_row, "TradesTimesPriceInTicks");
-		sc.SetSheetCellAsString(h, 0, TradesTimesPriceSquaredInTicks_row, "TradesTimesPriceSquaredInTicks");
-		sc.SetSheetCellAsString(h, 0, IBRHighPrice_row, "IBRHighPrice");
-		sc.SetSheetCellAsString(h, 0, IBRLowPrice_row, "IBRLowPrice");
-		sc.SetSheetCellAsString(h, 0, OpeningRangeHighPrice_row, "OpeningRangeHighPrice");
-		sc.SetSheetCellAsString(h, 0, OpeningRangeLowPrice_row, "OpeningRangeLowPrice");
-		sc.SetSheetCellAsString(h, 0, VolumeWeightedAveragePrice_row, "VolumeWeightedAveragePrice");
-		sc.SetSheetCellAsString(h, 0, MaxTPOBlocksCount_row, "MaxTPOBlocksCount");
-		sc.SetSheetCellAsString(h, 0, TPOCountMaxDigits_row, "TPOCountMaxDigits");
-		sc.SetSheetCellAsString(h, 0, DisplayIndependentColumns_row, "DisplayIndependentColumns");
-		sc.SetSheetCellAsString(h, 0, EveningSession_row, "EveningSession");
-		sc.SetSheetCellAsString(h, 0, AverageSubPeriodRange_row, "AverageSubPeriodRange");
-		sc.SetSheetCellAsString(h, 0, RotationFactor_row, "RotationFactor");
-		sc.SetSheetCellAsString(h, 0, VolumeAboveTPOPOC_row, "VolumeAboveTPOPOC");
-		sc.SetSheetCellAsString(h, 0, VolumeBelowTPOPOC_row, "VolumeBelowTPOPOC");
-		sc.SetSheetCellAsString(h, 0, EndDateTime_row, "EndDateTime");
-		sc.SetSheetCellAsString(h, 0, BeginIndex_row, "BeginIndex");
-		sc.SetSheetCellAsString(h, 0, EndIndex_row, "EndIndex");
+	if (rollover) {
+
+		w.set(0, StartDateTime_row, "StartDateTime");
+		w.set(0, NumberOfTrades_row, "NumberOfTrades");
+		w.set(0, Volume_row, "Volume");
+		w.set(0, BidVolume_row, "BidVolume");
+		w.set(0, AskVolume_row, "AskVolume");
+		w.set(0, TotalTPOCount_row, "TotalTPOCount");
+		w.set(0, OpenPrice_row, "OpenPrice");
+		w.set(0, HighestPrice_row, "Highest_price");
+		w.set(0, LowestPrice_row, "LowestPrice");
+		w.set(0, LastPrice_row, "LastPrice");
+		w.set(0, TPOMidpointPrice_row, "TPOMidpointPrice");
+		w.set(0, TPOMean_row, "TPOMean");
+		w.set(0, TPOStdDev_row, "TPOStdDev");
+		w.set(0, TPOErrorOfMean_row, "TPOErrorOfMean");
+		w.set(0, TPOMean_row, "TPOMean");
+		w.set(0, TPOPOCPrice_row, "TPOPOCPrice");
+		w.set(0, TPOValueAreaHigh_row, "TPOValueAreaHigh");
+		w.set(0, TPOValueAreaLow_row, "TPOValueAreaLow");
+		w.set(0, TPOCountAbovePOC_row, "TPOCountAbovePOC");
+		w.set(0, TPOCountBelowPOC_row, "TPOCountBelowPOC");
+		w.set(0, VolumeMidpointPrice_row, "VolumeMidpointPrice");
+		w.set(0, VolumePOCPrice_row, "VolumePOCPrice");
+		w.set(0, VolumeValueAreaHigh_row, "VolumeValueAreaHigh");
+		w.set(0, VolumeValueAreaLow, "VolumeValueAreaLow");
+		w.set(0, VolumeAbovePOC_row, "VolumeAbovePOC");
+		w.set(0, VolumeBelowPOC_row, "VolumeBelowPOC");
+		w.set(0, POCAboveBelowVolumeImbalancePercent_row, "POCAboveBelowVolumeImbalancePercent");
+		w.set(0, VolumeAboveLastPrice_row, "VolumeAboveLastPrice");
+		w.set(0, VolumeBelowLastPrice_row, "VolumeBelowLastPrice");
+		w.set(0, BidVolumeAbovePOC_row, "BidVolumeAbovePOC");
+		w.set(0, BidVolumeBelowPOC_row, "BidVolumeBelowPOC");
+		w.set(0, AskVolumeAbovePOC_row, "AskVolumeAbovePOC");
+		w.set(0, AskVolumeBelowPOC_row, "AskVolumeBelowPOC");
+		w.set(0, VolumeTimesPriceInTicks_row, "VolumeTimesPriceInTicks");
+		w.set(0, TradesTimesPriceInTicks_row, "TradesTimesPriceInTicks");
+		w.set(0, TradesTimesPriceSquaredInTicks_row, "TradesTimesPriceSquaredInTicks");
+		w.set(0, IBRHighPrice_row, "IBRHighPrice");
+		w.set(0, IBRLowPrice_row, "IBRLowPrice");
+		w.set(0, OpeningRangeHighPrice_row, "OpeningRangeHighPrice");
+		w.set(0, OpeningRangeLowPrice_row, "OpeningRangeLowPrice");
+		w.set(0, VolumeWeightedAveragePrice_row, "VolumeWeightedAveragePrice");
+		w.set(0, MaxTPOBlocksCount_row, "MaxTPOBlocksCount");
+		w.set(0, TPOCountMaxDigits_row, "TPOCountMaxDigits");
+		w.set(0, DisplayIndependentColumns_row, "DisplayIndependentColumns");
+		w.set(0, EveningSession_row, "EveningSession");
+		w.set(0, AverageSubPeriodRange_row, "AverageSubPeriodRange");
+		w.set(0, RotationFactor_row, "RotationFactor");
+		w.set(0, VolumeAboveTPOPOC_row, "VolumeAboveTPOPOC");
+		w.set(0, VolumeBelowTPOPOC_row, "VolumeBelowTPOPOC");
+		w.set(0, EndDateTime_row, "EndDateTime");
+		w.set(0, BeginIndex_row, "BeginIndex");
+		w.set(0, EndIndex_row, "EndIndex");
 	
 	}
     
+	if (!rollover) {
+
+		tpo_write_profile(w, 1, p);
+
+		w.flush();
+
+		return;
+
+	}
+
 	// copy TPO values into spreadsheet
 
 	int j = 1; // column
 
 	for (int i = 0; i < num_profiles; i++) {
 
-		n_ACSIL::s_StudyProfileInformation p;
+		if (sc.GetStudyProfileInformation(study_id, i, p)) {
 
-		int res = sc.GetStudyProfileInformation(study_id, i, p);
-		
-		if (res) {
-			
-			// sc.SetSheetCellAsString(h, j, StartDateTime_row, p.m_StartDateTime);
-			sc.SetSheetCellAsDouble(h, j, NumberOfTrades_row, p.m_NumberOfTrades);
-			sc.SetSheetCellAsDouble(h, j, Volume_row, p.m_Volume);
-			sc.SetSheetCellAsDouble(h, j, BidVolume_row, p.m_BidVolume);
-			sc.SetSheetCellAsDouble(h, j, AskVolume_row, p.m_AskVolume);
-			sc.SetSheetCellAsDouble(h, j, TotalTPOCount_row, p.m_TotalTPOCount);
-			sc.SetSheetCellAsDouble(h, j, OpenPrice_row, p.m_OpenPrice);
-			sc.SetSheetCellAsDouble(h, j, HighestPrice_row, p.m_HighestPrice);
-			sc.SetSheetCellAsDouble(h, j, LowestPrice_row, p.m_LowestPrice);
-			sc.SetSheetCellAsDouble(h, j, LastPrice_row, p.m_LastPrice);
-			sc.SetSheetCellAsDouble(h, j, TPOMidpointPrice_row, p.m_TPOMidpointPrice);
-			sc.SetSheetCellAsDouble(h, j, TPOMean_row, p.m_TPOMean);
-			sc.SetSheetCellAsDouble(h, j, TPOStdDev_row, p.m_TPOStdDev);
-			sc.SetSheetCellAsDouble(h, j, TPOErrorOfMean_row, p.m_TPOErrorOfMean);
-			sc.SetSheetCellAsDouble(h, j, TPOMean_row, p.m_TPOMean);
-			sc.SetSheetCellAsDouble(h, j, TPOPOCPrice_row, p.m_TPOPOCPrice);
-			sc.SetSheetCellAsDouble(h, j, TPOValueAreaHigh_row, p.m_TPOValueAreaHigh);
-			sc.SetSheetCellAsDouble(h, j, TPOValueAreaLow_row, p.m_TPOValueAreaLow);
-			sc.SetSheetCellAsDouble(h, j, TPOCountAbovePOC_row, p.m_TPOCountAbovePOC);
-			sc.SetSheetCellAsDouble(h, j, TPOCountBelowPOC_row, p.m_TPOCountBelowPOC);
-			sc.SetSheetCellAsDouble(h, j, VolumeMidpointPrice_row, p.m_VolumeMidpointPrice);
-			sc.SetSheetCellAsDouble(h, j, VolumePOCPrice_row, p.m_VolumePOCPrice);
-			sc.SetSheetCellAsDouble(h, j, VolumeValueAreaHigh_row, p.m_VolumeValueAreaHigh);
-			sc.SetSheetCellAsDouble(h, j, VolumeValueAreaLow, p.m_VolumeValueAreaLow);
-			sc.SetSheetCellAsDouble(h, j, VolumeAbovePOC_row, p.m_VolumeAbovePOC);
-			sc.SetSheetCellAsDouble(h, j, VolumeBelowPOC_row, p.m_VolumeBelowPOC);
-			sc.SetSheetCellAsDouble(h, j, POCAboveBelowVolumeImbalancePercent_row, p.m_POCAboveBelowVolumeImbalancePercent);
-			sc.SetSheetCellAsDouble(h, j, VolumeAboveLastPrice_row, p.m_VolumeAboveLastPrice);
-			sc.SetSheetCellAsDouble(h, j, VolumeBelowLastPrice_row, p.m_VolumeBelowLastPrice);
-			sc.SetSheetCellAsDouble(h, j, BidVolumeAbovePOC_row, p.m_BidVolumeAbovePOC);
-			sc.SetSheetCellAsDouble(h, j, BidVolumeBelowPOC_row, p.m_BidVolumeBelowPOC);
-			sc.SetSheetCellAsDouble(h, j, AskVolumeAbovePOC_row, p.m_AskVolumeAbovePOC);
-			sc.SetSheetCellAsDouble(h, j, AskVolumeBelowPOC_row, p.m_AskVolumeBelowPOC);
-			sc.SetSheetCellAsDouble(h, j, VolumeTimesPriceInTicks_row, p.m_VolumeTimesPriceInTicks);
-			sc.SetSheetCellAsDouble(h, j, TradesTimesPriceInTicks_row, p.m_TradesTimesPriceInTicks);
-			sc.SetSheetCellAsDouble(h, j, TradesTimesPriceSquaredInTicks_row, p.m_TradesTimesPriceSquaredInTicks);
-			sc.SetSheetCellAsDouble(h, j, IBRHighPrice_row, p.m_IBRHighPrice);
-			sc.SetSheetCellAsDouble(h, j, IBRLowPrice_row, p.m_IBRLowPrice);
-			sc.SetSheetCellAsDouble(h, j, OpeningRangeHighPrice_row, p.m_OpeningRangeHighPrice);
-			sc.SetSheetCellAsDouble(h, j, OpeningRangeLowPrice_row, p.m_OpeningRangeLowPrice);
-			sc.SetSheetCellAsDouble(h, j, VolumeWeightedAveragePrice_row, p.m_VolumeWeightedAveragePrice);
-			sc.SetSheetCellAsDouble(h, j, MaxTPOBlocksCount_row, p.m_MaxTPOBlocksCount);
-			sc.SetSheetCellAsDouble(h, j, TPOCountMaxDigits_row, p.m_TPOCountMaxDigits);
-			// sc.SetSheetCellAsDouble(h, j, DisplayIndependentColumns_row, p.m_DisplayIndependentColumns);
-			sc.SetSheetCellAsDouble(h, j, EveningSession_row, p.m_EveningSession);
-			sc.SetSheetCellAsDouble(h, j, AverageSubPeriodRange_row, p.m_AverageSubPeriodRange);
-			sc.SetSheetCellAsDouble(h, j, RotationFactor_row, p.m_RotationFactor);
-			sc.SetSheetCellAsDouble(h, j, VolumeAboveTPOPOC_row, p.m_VolumeAboveTPOPOC);
-			sc.SetSheetCellAsDouble(h, j, VolumeBelowTPOPOC_row, p.m_VolumeBelowTPOPOC);
-			// sc.SetSheetCellAsString(h, j, EndDateTime_row, p.m_EndDateTime);
-			sc.SetSheetCellAsDouble(h, j, BeginIndex_row, p.m_BeginIndex);
-			sc.SetSheetCellAsDouble(h, j, EndIndex_row, p.m_EndIndex);
+			tpo_write_profile(w, j, p);
 
 			j++;
-	
-		}
 
-		if (initialized)
+		}
 
-			// only update the latest profile after the first run.
-			// need to restart the study after a new session.
+	}
 
-			break;
-	
+	w.flush();
 
-	}
 }
\ No newline at end of file